@@ -0,0 +1,391 @@
+#include "bulkdownloader.h"
+
+#include "checksum.h"
+#include "filesink.h"
+#include "memorybudget.h"
+#include "redirectcache.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtNetwork/QNetworkRequest>
+
+namespace
+{
+    constexpr int kMaxRedirects{5};
+    constexpr int kDefaultMaxInFlight{12};
+    constexpr qint64 kMaxBulkFileBytes{16 * 1024 * 1024};
+    constexpr int kCheckpointEvery{500};
+    constexpr qint64 kReportIntervalMs{250};
+    const char *const kOversizedProperty{"downmanOversized"};
+}
+
+BulkDownloader::BulkDownloader(QObject *parent)
+    : QObject(parent), manager_(this), maxInFlight_(kDefaultMaxInFlight)
+{
+}
+
+void BulkDownloader::start(const QList<Job> &jobs)
+{
+    abortReplies();
+
+    jobs_ = jobs;
+    done_ = QVector<bool>(jobs_.size(), false);
+    next_ = 0;
+    completed_ = 0;
+    skipped_ = 0;
+    failed_ = 0;
+    sinceCheckpoint_ = 0;
+    lastReportMs_ = 0;
+    active_ = true;
+    clock_.start();
+
+    // One checkpoint covers the whole batch up front; it is only rewritten
+    // every few hundred files rather than once per file.
+    persistCheckpoint();
+    launchMore();
+}
+
+void BulkDownloader::cancel()
+{
+    if (!active_)
+    {
+        return;
+    }
+
+    abortReplies();
+    active_ = false;
+    persistCheckpoint();
+    emit finished(completed_, skipped_, failed_);
+}
+
+void BulkDownloader::setMaxInFlight(int count)
+{
+    maxInFlight_ = qMax(1, count);
+}
+
+void BulkDownloader::setDurabilityPolicy(DownloadItem::DurabilityPolicy policy)
+{
+    durability_ = policy;
+}
+
+bool BulkDownloader::isActive() const
+{
+    return active_;
+}
+
+double BulkDownloader::filesPerSecond() const
+{
+    const double seconds{clock_.isValid() ? static_cast<double>(clock_.elapsed()) / 1000.0 : 0.0};
+    return seconds > 0.0 ? completed_ / seconds : 0.0;
+}
+
+QList<BulkDownloader::Job> BulkDownloader::loadCheckpoint()
+{
+    QFile file{checkpointPath()};
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return {};
+    }
+
+    QList<Job> jobs{};
+    const QJsonArray entries{QJsonDocument::fromJson(file.readAll()).object().value(QStringLiteral("pending")).toArray()};
+    for (const auto &value : entries)
+    {
+        const QJsonObject entry{value.toObject()};
+        Job job{};
+        job.url = QUrl{entry.value(QStringLiteral("url")).toString()};
+        job.filePath = entry.value(QStringLiteral("path")).toString();
+        job.expected.size = static_cast<qint64>(entry.value(QStringLiteral("size")).toDouble(-1));
+        job.expected.hashType = entry.value(QStringLiteral("hashType")).toString();
+        job.expected.hash = entry.value(QStringLiteral("hash")).toString().toLatin1();
+        const QJsonArray mirrors{entry.value(QStringLiteral("mirrors")).toArray()};
+        for (const auto &mirror : mirrors)
+        {
+            job.mirrors.append(QUrl{mirror.toString()});
+        }
+        if (job.url.isValid() && !job.filePath.isEmpty())
+        {
+            jobs.append(job);
+        }
+    }
+    return jobs;
+}
+
+void BulkDownloader::clearCheckpoint()
+{
+    QFile::remove(checkpointPath());
+}
+
+void BulkDownloader::launchMore()
+{
+    while (active_ && replies_.size() < maxInFlight_ && next_ < jobs_.size())
+    {
+        const int index{next_};
+        const Job &job{jobs_.at(index)};
+
+        // Every body is held in memory until it is written, so in-flight
+        // files must fit the shared budget; one is always allowed through.
+        const qint64 limit{job.expected.size >= 0 ? qMin(job.expected.size, kMaxBulkFileBytes) : kMaxBulkFileBytes};
+        const qint64 wanted{inFlightBytes_ + limit};
+        if (MemoryBudget::instance().reserve(this, wanted) < wanted && !replies_.isEmpty())
+        {
+            MemoryBudget::instance().reserve(this, inFlightBytes_);
+            break;
+        }
+        ++next_;
+
+        const bool hasExpectation{job.expected.size >= 0 || !job.expected.hash.isEmpty()};
+        if (hasExpectation && QFileInfo::exists(job.filePath)
+            && Checksum::verifyFile(job.filePath, job.expected.size, job.expected.hashType, job.expected.hash))
+        {
+            MemoryBudget::instance().reserve(this, inFlightBytes_);
+            done_[index] = true;
+            ++skipped_;
+            emit fileSkipped(index, job.filePath);
+            recordDone();
+            continue;
+        }
+
+        // Small bodies are latency bound, so let the shared manager queue
+        // several requests on each keep-alive connection to the host.
+        QNetworkRequest request{RedirectCache::instance().resolve(job.url, kMaxRedirects)};
+        request.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+        request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+        request.setMaximumRedirectsAllowed(kMaxRedirects);
+
+        QNetworkReply *reply{manager_.get(request)};
+        replies_.insert(reply, limit);
+        inFlightBytes_ += limit;
+        const auto checkSize{[reply, limit](qint64 bytes)
+                             {
+                                 if (bytes > limit)
+                                 {
+                                     reply->setProperty(kOversizedProperty, true);
+                                     reply->abort();
+                                 }
+                             }};
+        connect(reply, &QNetworkReply::metaDataChanged, this, [reply, checkSize]()
+                {
+                    const QVariant length{reply->header(QNetworkRequest::ContentLengthHeader)};
+                    if (length.isValid())
+                    {
+                        checkSize(length.toLongLong());
+                    }
+                });
+        connect(reply, &QNetworkReply::downloadProgress, this, [checkSize](qint64 received, qint64)
+                { checkSize(received); });
+        connect(reply, &QNetworkReply::finished, this, [this, reply, index]()
+                { handleReplyFinished(reply, index); });
+    }
+
+    if (active_ && replies_.isEmpty() && next_ >= jobs_.size())
+    {
+        active_ = false;
+        MemoryBudget::instance().release(this);
+        // Failed files stay checkpointed until their mirror retries are over.
+        if (failed_ > 0)
+        {
+            persistCheckpoint();
+        }
+        else
+        {
+            clearCheckpoint();
+        }
+        emit progressChanged(completed_ + skipped_ + failed_, jobs_.size(), filesPerSecond());
+        emit finished(completed_, skipped_, failed_);
+    }
+}
+
+void BulkDownloader::abortReplies()
+{
+    const QList<QNetworkReply *> replies{replies_.keys()};
+    replies_.clear();
+    inFlightBytes_ = 0;
+    MemoryBudget::instance().release(this);
+    for (QNetworkReply *reply : replies)
+    {
+        reply->disconnect(this);
+        reply->abort();
+        reply->deleteLater();
+    }
+}
+
+void BulkDownloader::handleReplyFinished(QNetworkReply *reply, int index)
+{
+    inFlightBytes_ -= replies_.take(reply);
+    reply->deleteLater();
+
+    const Job &job{jobs_.at(index)};
+    QString errorText{};
+    if (reply->property(kOversizedProperty).toBool())
+    {
+        errorText = job.expected.size >= 0 ? QStringLiteral("Size mismatch") : QStringLiteral("File is too large for bulk mode");
+    }
+    else if (reply->error() != QNetworkReply::NoError)
+    {
+        errorText = reply->errorString();
+    }
+    else
+    {
+        storeFile(job, reply->readAll(), &errorText);
+    }
+    MemoryBudget::instance().reserve(this, inFlightBytes_);
+
+    if (errorText.isEmpty())
+    {
+        done_[index] = true;
+        ++completed_;
+        emit fileFinished(index, job.filePath);
+    }
+    else
+    {
+        ++failed_;
+        emit fileFailed(index, job.filePath, errorText);
+    }
+
+    recordDone();
+    launchMore();
+}
+
+bool BulkDownloader::storeFile(const Job &job, const QByteArray &data, QString *errorText)
+{
+    if (job.expected.size >= 0 && data.size() != job.expected.size)
+    {
+        *errorText = QStringLiteral("Size mismatch");
+        return false;
+    }
+
+    // Check the digest on the buffer in hand instead of reading the file back.
+    if (!job.expected.hash.isEmpty())
+    {
+        const auto algorithm{Checksum::algorithmFor(job.expected.hashType)};
+        if (!algorithm)
+        {
+            *errorText = QStringLiteral("Unsupported hash type: %1").arg(job.expected.hashType);
+            return false;
+        }
+        if (QCryptographicHash::hash(data, *algorithm).toHex() != job.expected.hash.trimmed().toLower())
+        {
+            *errorText = QStringLiteral("Checksum mismatch");
+            return false;
+        }
+    }
+
+    if (!ensureDirectory(job.filePath))
+    {
+        *errorText = QStringLiteral("Cannot create directory for %1").arg(job.filePath);
+        return false;
+    }
+
+    // A file only counts as done in the checkpoint once it is whole on
+    // disk, so write it aside and sync it per policy before the rename.
+    QSaveFile file{job.filePath};
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size())
+    {
+        *errorText = file.errorString();
+        return false;
+    }
+    if (durability_ != DownloadItem::DurabilityPolicy::None && !FileSink::syncToDisk(file))
+    {
+        *errorText = QStringLiteral("Failed to sync file to disk.");
+        return false;
+    }
+    if (!file.commit())
+    {
+        *errorText = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool BulkDownloader::ensureDirectory(const QString &filePath)
+{
+    const QString dir{QFileInfo(filePath).path()};
+    if (knownDirs_.contains(dir))
+    {
+        return true;
+    }
+
+    if (!QDir{}.mkpath(dir))
+    {
+        return false;
+    }
+    knownDirs_.insert(dir);
+    return true;
+}
+
+void BulkDownloader::recordDone()
+{
+    if (++sinceCheckpoint_ >= kCheckpointEvery)
+    {
+        sinceCheckpoint_ = 0;
+        persistCheckpoint();
+    }
+
+    const qint64 elapsed{clock_.elapsed()};
+    if (elapsed - lastReportMs_ >= kReportIntervalMs)
+    {
+        lastReportMs_ = elapsed;
+        emit progressChanged(completed_ + skipped_ + failed_, jobs_.size(), filesPerSecond());
+    }
+}
+
+void BulkDownloader::persistCheckpoint() const
+{
+    QJsonArray pending{};
+    for (int i = 0; i < jobs_.size(); ++i)
+    {
+        if (done_.at(i))
+        {
+            continue;
+        }
+
+        const Job &job{jobs_.at(i)};
+        QJsonObject entry{};
+        entry.insert(QStringLiteral("url"), job.url.toString());
+        entry.insert(QStringLiteral("path"), job.filePath);
+        if (job.expected.size >= 0)
+        {
+            entry.insert(QStringLiteral("size"), static_cast<double>(job.expected.size));
+        }
+        if (!job.expected.hash.isEmpty())
+        {
+            entry.insert(QStringLiteral("hashType"), job.expected.hashType);
+            entry.insert(QStringLiteral("hash"), QString::fromLatin1(job.expected.hash));
+        }
+        if (!job.mirrors.isEmpty())
+        {
+            QJsonArray mirrors{};
+            for (const auto &mirror : job.mirrors)
+            {
+                mirrors.append(mirror.toString());
+            }
+            entry.insert(QStringLiteral("mirrors"), mirrors);
+        }
+        pending.append(entry);
+    }
+
+    QJsonObject root{};
+    root.insert(QStringLiteral("pending"), pending);
+
+    QSaveFile file{checkpointPath()};
+    if (file.open(QIODevice::WriteOnly))
+    {
+        file.write(QJsonDocument{root}.toJson(QJsonDocument::Compact));
+        file.commit();
+    }
+}
+
+QString BulkDownloader::checkpointPath()
+{
+    const QString dir{QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)};
+    QDir{}.mkpath(dir);
+    return dir + QStringLiteral("/bulk-checkpoint.json");
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QUrl>
+#include <QVector>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkReply>
+
+#include "downloaditem.h"
+
+class BulkDownloader : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Job
+    {
+        QUrl url{};
+        QString filePath{};
+        DownloadItem::Expected expected{};
+        // Not tried here; kept so a resumed batch still knows its fallbacks.
+        QList<QUrl> mirrors{};
+    };
+
+    explicit BulkDownloader(QObject *parent = nullptr);
+
+    void start(const QList<Job> &jobs);
+    void cancel();
+    void setMaxInFlight(int count);
+    void setDurabilityPolicy(DownloadItem::DurabilityPolicy policy);
+
+    bool isActive() const;
+    double filesPerSecond() const;
+
+    static QList<Job> loadCheckpoint();
+    static void clearCheckpoint();
+
+signals:
+    void fileFinished(int index, const QString &filePath);
+    void fileSkipped(int index, const QString &filePath);
+    void fileFailed(int index, const QString &filePath, const QString &errorText);
+    void progressChanged(int filesDone, int filesTotal, double filesPerSecond);
+    void finished(int completed, int skipped, int failed);
+
+private:
+    void launchMore();
+    void abortReplies();
+    void handleReplyFinished(QNetworkReply *reply, int index);
+    bool storeFile(const Job &job, const QByteArray &data, QString *errorText);
+    bool ensureDirectory(const QString &filePath);
+    void recordDone();
+    void persistCheckpoint() const;
+    static QString checkpointPath();
+
+    QNetworkAccessManager manager_{};
+    QList<Job> jobs_{};
+    QVector<bool> done_{};
+    QSet<QString> knownDirs_{};
+    QHash<QNetworkReply *, qint64> replies_{};
+    qint64 inFlightBytes_{0};
+    QElapsedTimer clock_{};
+    qint64 lastReportMs_{0};
+    int next_{0};
+    int maxInFlight_;
+    int completed_{0};
+    int skipped_{0};
+    int failed_{0};
+    int sinceCheckpoint_{0};
+    bool active_{false};
+    DownloadItem::DurabilityPolicy durability_{DownloadItem::DurabilityPolicy::Periodic};
+};
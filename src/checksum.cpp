@@ -0,0 +1,111 @@
+#include "checksum.h"
+
+#include <QFile>
+#include <QFileInfo>
+
+namespace
+{
+    QString normalizedType(const QString &hashType)
+    {
+        QString type{hashType.trimmed().toLower()};
+        type.remove(QLatin1Char('-'));
+        type.remove(QLatin1Char('_'));
+        return type;
+    }
+}
+
+std::optional<QCryptographicHash::Algorithm> Checksum::algorithmFor(const QString &hashType)
+{
+    const QString type{normalizedType(hashType)};
+    if (type == QLatin1String("md5"))
+    {
+        return QCryptographicHash::Md5;
+    }
+    if (type == QLatin1String("sha1"))
+    {
+        return QCryptographicHash::Sha1;
+    }
+    if (type == QLatin1String("sha256"))
+    {
+        return QCryptographicHash::Sha256;
+    }
+    if (type == QLatin1String("sha384"))
+    {
+        return QCryptographicHash::Sha384;
+    }
+    if (type == QLatin1String("sha512"))
+    {
+        return QCryptographicHash::Sha512;
+    }
+    return std::nullopt;
+}
+
+int Checksum::strength(const QString &hashType)
+{
+    const QString type{normalizedType(hashType)};
+    if (type == QLatin1String("sha512"))
+    {
+        return 5;
+    }
+    if (type == QLatin1String("sha384"))
+    {
+        return 4;
+    }
+    if (type == QLatin1String("sha256"))
+    {
+        return 3;
+    }
+    if (type == QLatin1String("sha1"))
+    {
+        return 2;
+    }
+    if (type == QLatin1String("md5"))
+    {
+        return 1;
+    }
+    return 0;
+}
+
+QByteArray Checksum::fileDigest(const QString &path, QCryptographicHash::Algorithm algorithm)
+{
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return {};
+    }
+
+    QCryptographicHash hash{algorithm};
+    if (!hash.addData(&file))
+    {
+        return {};
+    }
+
+    return hash.result().toHex();
+}
+
+bool Checksum::verifyFile(const QString &path, qint64 expectedSize, const QString &hashType, const QByteArray &expectedHex)
+{
+    const QFileInfo info{path};
+    if (!info.exists() || !info.isFile())
+    {
+        return false;
+    }
+
+    if (expectedSize >= 0 && info.size() != expectedSize)
+    {
+        return false;
+    }
+
+    if (expectedHex.isEmpty())
+    {
+        return expectedSize >= 0;
+    }
+
+    const auto algorithm{algorithmFor(hashType)};
+    if (!algorithm)
+    {
+        return false;
+    }
+
+    return fileDigest(path, *algorithm) == expectedHex.trimmed().toLower();
+}
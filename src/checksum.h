@@ -0,0 +1,15 @@
+#pragma once
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QString>
+
+#include <optional>
+
+namespace Checksum
+{
+    std::optional<QCryptographicHash::Algorithm> algorithmFor(const QString &hashType);
+    int strength(const QString &hashType);
+    QByteArray fileDigest(const QString &path, QCryptographicHash::Algorithm algorithm);
+    bool verifyFile(const QString &path, qint64 expectedSize, const QString &hashType, const QByteArray &expectedHex);
+}
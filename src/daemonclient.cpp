@@ -0,0 +1,146 @@
+#include "daemonclient.h"
+
+#include "downloaddaemon.h"
+
+#include <QJsonDocument>
+
+DaemonClient::DaemonClient(QObject *parent)
+    : QObject(parent), socket_(this)
+{
+    connect(&socket_, &QLocalSocket::readyRead, this, &DaemonClient::handleReadyRead);
+    connect(&socket_, &QLocalSocket::disconnected, this, &DaemonClient::connectionLost);
+}
+
+bool DaemonClient::connectToDaemon(int timeoutMs)
+{
+    socket_.connectToServer(DownloadDaemon::serverName());
+    return socket_.waitForConnected(timeoutMs);
+}
+
+bool DaemonClient::isConnected() const
+{
+    return socket_.state() == QLocalSocket::ConnectedState;
+}
+
+void DaemonClient::enqueue(const QUrl &url, const QString &filePath, const DownloadItem::Expected &expected,
+                           const QList<QUrl> &mirrors)
+{
+    QJsonObject request{};
+    request.insert(QStringLiteral("url"), url.toString());
+    if (!mirrors.isEmpty())
+    {
+        QJsonArray values{};
+        for (const auto &mirror : mirrors)
+        {
+            values.append(mirror.toString());
+        }
+        request.insert(QStringLiteral("mirrors"), values);
+    }
+    if (!filePath.isEmpty())
+    {
+        request.insert(QStringLiteral("path"), filePath);
+    }
+    if (expected.size >= 0)
+    {
+        request.insert(QStringLiteral("size"), static_cast<double>(expected.size));
+    }
+    if (!expected.hashType.isEmpty())
+    {
+        request.insert(QStringLiteral("hashType"), expected.hashType);
+        request.insert(QStringLiteral("hash"), QString::fromLatin1(expected.hash));
+    }
+    send(QStringLiteral("enqueue"), request);
+}
+
+void DaemonClient::pause(int item)
+{
+    sendItemCommand(QStringLiteral("pause"), item);
+}
+
+void DaemonClient::resume(int item)
+{
+    sendItemCommand(QStringLiteral("resume"), item);
+}
+
+void DaemonClient::cancel(int item)
+{
+    sendItemCommand(QStringLiteral("cancel"), item);
+}
+
+void DaemonClient::requestList()
+{
+    send(QStringLiteral("list"));
+}
+
+void DaemonClient::subscribe()
+{
+    send(QStringLiteral("subscribe"));
+}
+
+void DaemonClient::handleReadyRead()
+{
+    while (socket_.canReadLine())
+    {
+        const QJsonDocument document{QJsonDocument::fromJson(socket_.readLine())};
+        if (document.isObject())
+        {
+            handleMessage(document.object());
+        }
+    }
+}
+
+void DaemonClient::send(const QString &command, QJsonObject request)
+{
+    request.insert(QStringLiteral("cmd"), command);
+    socket_.write(QJsonDocument{request}.toJson(QJsonDocument::Compact) + '\n');
+}
+
+void DaemonClient::sendItemCommand(const QString &command, int item)
+{
+    QJsonObject request{};
+    request.insert(QStringLiteral("item"), item);
+    send(command, request);
+}
+
+void DaemonClient::handleMessage(const QJsonObject &message)
+{
+    const int item{message.value(QStringLiteral("item")).toInt(-1)};
+
+    if (message.contains(QStringLiteral("reply")))
+    {
+        const QString reply{message.value(QStringLiteral("reply")).toString()};
+        if (!message.value(QStringLiteral("ok")).toBool())
+        {
+            emit requestFailed(reply, message.value(QStringLiteral("error")).toString());
+        }
+        else if (reply == QLatin1String("enqueue"))
+        {
+            emit enqueued(item);
+        }
+        else if (reply == QLatin1String("list"))
+        {
+            emit listReceived(message.value(QStringLiteral("items")).toArray());
+        }
+        return;
+    }
+
+    const QString event{message.value(QStringLiteral("event")).toString()};
+    if (event == QLatin1String("progress"))
+    {
+        emit itemProgress(item,
+                          static_cast<qint64>(message.value(QStringLiteral("received")).toDouble()),
+                          static_cast<qint64>(message.value(QStringLiteral("total")).toDouble(-1)),
+                          message.value(QStringLiteral("speed")).toDouble());
+    }
+    else if (event == QLatin1String("state"))
+    {
+        emit itemStateChanged(item,
+                              message.value(QStringLiteral("state")).toString(),
+                              message.value(QStringLiteral("path")).toString(),
+                              message.value(QStringLiteral("error")).toString());
+    }
+    else if (event == QLatin1String("status"))
+    {
+        emit itemStatusText(item, message.value(QStringLiteral("text")).toString());
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QUrl>
+#include <QtNetwork/QLocalSocket>
+
+#include "downloaditem.h"
+
+class DaemonClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DaemonClient(QObject *parent = nullptr);
+
+    bool connectToDaemon(int timeoutMs = 1000);
+    bool isConnected() const;
+
+    void enqueue(const QUrl &url, const QString &filePath, const DownloadItem::Expected &expected = {},
+                 const QList<QUrl> &mirrors = {});
+    void pause(int item);
+    void resume(int item);
+    void cancel(int item);
+    void requestList();
+    void subscribe();
+
+signals:
+    void enqueued(int item);
+    void requestFailed(const QString &command, const QString &errorText);
+    void listReceived(const QJsonArray &items);
+    void itemStateChanged(int item, const QString &state, const QString &filePath, const QString &errorText);
+    void itemProgress(int item, qint64 bytesReceived, qint64 bytesTotal, double kilobytesPerSecond);
+    void itemStatusText(int item, const QString &text);
+    void connectionLost();
+
+private slots:
+    void handleReadyRead();
+
+private:
+    void send(const QString &command, QJsonObject request = {});
+    void sendItemCommand(const QString &command, int item);
+    void handleMessage(const QJsonObject &message);
+
+    QLocalSocket socket_{};
+};
@@ -0,0 +1,127 @@
+#include "datasink.h"
+
+#include <utility>
+
+bool DataSink::flush()
+{
+    return true;
+}
+
+bool DataSink::close()
+{
+    return true;
+}
+
+qint64 DataSink::pendingBytes() const
+{
+    return 0;
+}
+
+QString DataSink::errorString() const
+{
+    return errorString_;
+}
+
+bool DataSink::fail(const QString &text)
+{
+    errorString_ = text;
+    return false;
+}
+
+void TeeSink::addSink(std::unique_ptr<DataSink> sink, bool required)
+{
+    if (sink)
+    {
+        children_.push_back(Child{std::move(sink), required});
+    }
+}
+
+void TeeSink::removeOptionalSinks()
+{
+    for (auto it{children_.begin()}; it != children_.end();)
+    {
+        if (it->required)
+        {
+            ++it;
+            continue;
+        }
+        it->sink->close();
+        it = children_.erase(it);
+    }
+}
+
+QStringList TeeSink::takeDetached()
+{
+    return std::exchange(detached_, {});
+}
+
+QString TeeSink::name() const
+{
+    return QStringLiteral("tee");
+}
+
+template <typename Operation>
+bool TeeSink::forEachChild(Operation operation)
+{
+    // Optional consumers that fail are dropped so they cannot stall or
+    // break the download; only a required sink failing is fatal.
+    for (auto it{children_.begin()}; it != children_.end();)
+    {
+        if (operation(*it->sink))
+        {
+            ++it;
+            continue;
+        }
+
+        if (it->required)
+        {
+            return fail(it->sink->errorString());
+        }
+
+        detached_ << it->sink->name() + QStringLiteral(" (") + it->sink->errorString() + QLatin1Char(')');
+        it = children_.erase(it);
+    }
+    return true;
+}
+
+bool TeeSink::open(qint64 offset)
+{
+    return forEachChild([offset](DataSink &sink)
+                        { return sink.open(offset); });
+}
+
+bool TeeSink::write(const QByteArray &data)
+{
+    return forEachChild([&data](DataSink &sink)
+                        { return sink.write(data); });
+}
+
+bool TeeSink::flush()
+{
+    return forEachChild([](DataSink &sink)
+                        { return sink.flush(); });
+}
+
+bool TeeSink::close()
+{
+    // Every child gets closed; only a required one failing is reported.
+    bool closed{true};
+    for (auto &child : children_)
+    {
+        if (!child.sink->close() && child.required && closed)
+        {
+            closed = fail(child.sink->errorString());
+        }
+    }
+    return closed;
+}
+
+qint64 TeeSink::pendingBytes() const
+{
+    qint64 pending{0};
+    for (const auto &child : children_)
+    {
+        pending = qMax(pending, child.sink->pendingBytes());
+    }
+    return pending;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+#include <vector>
+
+class DataSink
+{
+public:
+    virtual ~DataSink() = default;
+
+    virtual QString name() const = 0;
+    virtual bool open(qint64 offset) = 0;
+    virtual bool write(const QByteArray &data) = 0;
+    virtual bool flush();
+    virtual bool close();
+    virtual qint64 pendingBytes() const;
+
+    QString errorString() const;
+
+protected:
+    bool fail(const QString &text);
+
+private:
+    QString errorString_{};
+};
+
+class TeeSink : public DataSink
+{
+public:
+    void addSink(std::unique_ptr<DataSink> sink, bool required = false);
+    void removeOptionalSinks();
+    QStringList takeDetached();
+
+    QString name() const override;
+    bool open(qint64 offset) override;
+    bool write(const QByteArray &data) override;
+    bool flush() override;
+    bool close() override;
+    qint64 pendingBytes() const override;
+
+private:
+    struct Child
+    {
+        std::unique_ptr<DataSink> sink{};
+        bool required{false};
+    };
+
+    template <typename Operation>
+    bool forEachChild(Operation operation);
+
+    std::vector<Child> children_{};
+    QStringList detached_{};
+};
@@ -0,0 +1,820 @@
+#include "deltasync.h"
+
+#include "memorybudget.h"
+#include "redirectcache.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QStorageInfo>
+#include <QStringList>
+#include <QtNetwork/QNetworkRequest>
+
+#include <utility>
+
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+#include <string>
+#else
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr int kMaxRedirects{5};
+    constexpr qint64 kMinBlockSize{512};
+    constexpr qint64 kMaxBlockSize{1024 * 1024};
+    constexpr qint64 kMaxControlBytes{64LL * 1024LL * 1024LL};
+    constexpr qint64 kMaxFileBytes{1024LL * 1024LL * 1024LL}; // same cap as a full download
+    constexpr qint64 kScanChunkBytes{1024 * 1024};
+    constexpr qint64 kScanStepBytes{4 * 1024 * 1024};
+    constexpr int kMaxRangesPerRequest{32};
+    constexpr qint64 kMaxBatchBytes{8 * 1024 * 1024};
+    // Allowance for the part headers of a multipart/byteranges response.
+    constexpr qint64 kPartOverheadBytes{512};
+
+    // Swaps the assembled file in with a single rename, so a failure at any
+    // point leaves the original target untouched.
+    bool replaceFile(const QString &from, const QString &to, QString *errorText)
+    {
+#ifdef Q_OS_WIN
+        const std::wstring source{QDir::toNativeSeparators(from).toStdWString()};
+        const std::wstring target{QDir::toNativeSeparators(to).toStdWString()};
+        if (!::MoveFileExW(source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        {
+            *errorText = qt_error_string(static_cast<int>(::GetLastError()));
+            return false;
+        }
+#else
+        if (std::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) != 0)
+        {
+            *errorText = QString::fromLocal8Bit(std::strerror(errno));
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    bool parseContentRange(const QByteArray &value, qint64 *start, qint64 *end)
+    {
+        // "bytes <first>-<last>/<total>"
+        const QByteArray trimmed{value.trimmed()};
+        if (!trimmed.toLower().startsWith("bytes "))
+        {
+            return false;
+        }
+
+        const QByteArray span{trimmed.mid(6).split('/').value(0)};
+        const QList<QByteArray> bounds{span.split('-')};
+        if (bounds.size() != 2)
+        {
+            return false;
+        }
+
+        bool firstOk{false};
+        bool lastOk{false};
+        const qint64 first{bounds.at(0).trimmed().toLongLong(&firstOk)};
+        const qint64 last{bounds.at(1).trimmed().toLongLong(&lastOk)};
+        if (!firstOk || !lastOk || first < 0 || last < first)
+        {
+            return false;
+        }
+
+        *start = first;
+        *end = last + 1;
+        return true;
+    }
+
+    QByteArray headerValue(const QByteArray &headers, const QByteArray &name)
+    {
+        for (const QByteArray &line : headers.split('\n'))
+        {
+            const qsizetype colon{line.indexOf(':')};
+            if (colon > 0 && line.left(colon).trimmed().toLower() == name)
+            {
+                return line.mid(colon + 1).trimmed();
+            }
+        }
+        return {};
+    }
+}
+
+DeltaSync::DeltaSync(QObject *parent)
+    : QObject(parent), manager_(this)
+{
+    scanTimer_.setInterval(0);
+    connect(&scanTimer_, &QTimer::timeout, this, &DeltaSync::handleScanStep);
+    seedTimer_.setInterval(0);
+    connect(&seedTimer_, &QTimer::timeout, this, &DeltaSync::handleSeedStep);
+    verifyTimer_.setInterval(0);
+    connect(&verifyTimer_, &QTimer::timeout, this, &DeltaSync::handleVerifyStep);
+}
+
+void DeltaSync::start(const QUrl &url, const QString &filePath, const QUrl &controlUrl)
+{
+    reset();
+
+    url_ = url;
+    targetPath_ = filePath;
+    tempPath_ = filePath + QStringLiteral(".zsync-part");
+    reused_ = 0;
+    fetched_ = 0;
+    active_ = true;
+
+    QUrl control{controlUrl};
+    if (!control.isValid())
+    {
+        control = url;
+        control.setPath(url.path() + QStringLiteral(".zsync"));
+    }
+
+    QNetworkRequest request{RedirectCache::instance().resolve(control, kMaxRedirects)};
+    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+    request.setMaximumRedirectsAllowed(kMaxRedirects);
+    reply_ = manager_.get(request);
+    replyLimit_ = kMaxControlBytes;
+    watchReply();
+    connect(reply_, &QNetworkReply::finished, this, &DeltaSync::handleControlFinished);
+
+    emit statusTextChanged(QStringLiteral("Fetching block map..."));
+}
+
+void DeltaSync::cancel()
+{
+    if (!active_)
+    {
+        return;
+    }
+
+    reset();
+    QFile::remove(tempPath_);
+    emit statusTextChanged(QStringLiteral("Cancelled"));
+}
+
+bool DeltaSync::isActive() const
+{
+    return active_;
+}
+
+qint64 DeltaSync::bytesReused() const
+{
+    return reused_;
+}
+
+qint64 DeltaSync::bytesFetched() const
+{
+    return fetched_;
+}
+
+void DeltaSync::handleControlFinished()
+{
+    QNetworkReply *reply{std::exchange(reply_, nullptr)};
+    reply->deleteLater();
+
+    if (reply->error() != QNetworkReply::NoError)
+    {
+        fail(QStringLiteral("No block map: %1").arg(reply->errorString()));
+        return;
+    }
+
+    QString errorText{};
+    const bool parsed{parseControl(reply->readAll(), &control_, &errorText)};
+    MemoryBudget::instance().release(this);
+    if (!parsed)
+    {
+        fail(errorText);
+        return;
+    }
+
+    localFile_.setFileName(targetPath_);
+    if (!localFile_.open(QIODevice::ReadOnly))
+    {
+        fail(QStringLiteral("Cannot read local copy: %1").arg(localFile_.errorString()));
+        return;
+    }
+
+    const int blocks{static_cast<int>(control_.weak.size())};
+    for (int block = 0; block < blocks; ++block)
+    {
+        weakIndex_[control_.weak[block]].push_back(block);
+    }
+    localOffsets_.assign(control_.weak.size(), -1);
+
+    scanBuffer_.clear();
+    scanBase_ = 0;
+    scanPos_ = 0;
+    scanPadded_ = false;
+    windowValid_ = false;
+
+    emit statusTextChanged(QStringLiteral("Scanning local copy..."));
+    scanTimer_.start();
+}
+
+void DeltaSync::handleScanStep()
+{
+    const qint64 blockSize{control_.blockSize};
+    const quint32 weakMask{control_.weakBytes >= 4 ? 0xffffffffU : (1U << (8 * control_.weakBytes)) - 1U};
+
+    // Scan in slices from the event loop so large files do not freeze the UI.
+    qint64 budget{kScanStepBytes};
+    while (budget > 0)
+    {
+        if (!fillScanWindow())
+        {
+            scanTimer_.stop();
+            weakIndex_.clear();
+            seedFromLocal();
+            return;
+        }
+
+        const char *window{scanBuffer_.constData() + scanPos_};
+        if (!windowValid_)
+        {
+            rollA_ = 0;
+            rollB_ = 0;
+            for (qint64 i = 0; i < blockSize; ++i)
+            {
+                const uchar c{static_cast<uchar>(window[i])};
+                rollA_ = static_cast<quint16>(rollA_ + c);
+                rollB_ = static_cast<quint16>(rollB_ + (blockSize - i) * c);
+            }
+            windowValid_ = true;
+        }
+
+        const quint32 weak{((static_cast<quint32>(rollA_) << 16) | rollB_) & weakMask};
+        const auto candidates{weakIndex_.constFind(weak)};
+        if (candidates != weakIndex_.constEnd() && matchWindow(window, *candidates))
+        {
+            scanPos_ += blockSize;
+            budget -= blockSize;
+            windowValid_ = false;
+            continue;
+        }
+
+        if (scanBuffer_.size() - scanPos_ <= blockSize)
+        {
+            scanPos_ = scanBuffer_.size();
+            continue;
+        }
+
+        const uchar out{static_cast<uchar>(window[0])};
+        const uchar in{static_cast<uchar>(window[blockSize])};
+        rollA_ = static_cast<quint16>(rollA_ + in - out);
+        rollB_ = static_cast<quint16>(rollB_ + rollA_ - blockSize * out);
+        ++scanPos_;
+        --budget;
+    }
+
+    emit progressChanged(qMin(scanBase_ + scanPos_, localFile_.size()), localFile_.size());
+}
+
+void DeltaSync::handleRangesFinished()
+{
+    QNetworkReply *reply{std::exchange(reply_, nullptr)};
+    reply->deleteLater();
+
+    if (reply->error() != QNetworkReply::NoError)
+    {
+        fail(reply->errorString());
+        return;
+    }
+
+    const bool stored{storeRangeReply(reply)};
+    MemoryBudget::instance().release(this);
+    if (stored)
+    {
+        requestNextBatch();
+    }
+}
+
+void DeltaSync::handleReplyMetaData()
+{
+    const int status{reply_->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt()};
+    if (status >= 300 && status < 400)
+    {
+        return;
+    }
+
+    // Both replies are held in memory until they finish, so refuse anything
+    // that cannot be used before its body arrives.
+    const bool ranged{reply_->request().hasRawHeader(QByteArrayLiteral("Range"))};
+    if (ranged && reply_->error() == QNetworkReply::NoError)
+    {
+        const bool multipart{reply_->rawHeader(QByteArrayLiteral("Content-Type")).toLower().startsWith("multipart/byteranges")};
+        if (status != 206)
+        {
+            fail(QStringLiteral("Server does not support range requests"));
+            return;
+        }
+        if (!multipart && !reply_->hasRawHeader(QByteArrayLiteral("Content-Range")))
+        {
+            fail(QStringLiteral("Malformed range response"));
+            return;
+        }
+    }
+
+    const QVariant length{reply_->header(QNetworkRequest::ContentLengthHeader)};
+    if (!length.isValid())
+    {
+        return;
+    }
+
+    handleReplyProgress(0, length.toLongLong());
+    if (!ranged && reply_)
+    {
+        // Range batches reserve their size up front; the block map's is
+        // only known now.
+        MemoryBudget::instance().reserve(this, length.toLongLong());
+    }
+}
+
+void DeltaSync::handleReplyProgress(qint64 bytesReceived, qint64 bytesTotal)
+{
+    if (bytesReceived > replyLimit_ || bytesTotal > replyLimit_)
+    {
+        const bool ranged{reply_->request().hasRawHeader(QByteArrayLiteral("Range"))};
+        fail(ranged ? QStringLiteral("Range response is too large") : QStringLiteral("Block map is too large"));
+    }
+}
+
+bool DeltaSync::parseControl(const QByteArray &data, ControlFile *control, QString *errorText)
+{
+    const qsizetype headerEnd{data.indexOf("\n\n")};
+    if (headerEnd < 0)
+    {
+        *errorText = QStringLiteral("Block map has no header");
+        return false;
+    }
+
+    ControlFile parsed{};
+    bool hasPlainUrl{false};
+    bool hasCompressedUrl{false};
+    for (const QByteArray &line : data.left(headerEnd).split('\n'))
+    {
+        const qsizetype colon{line.indexOf(':')};
+        if (colon <= 0)
+        {
+            continue;
+        }
+
+        const QByteArray key{line.left(colon).trimmed().toLower()};
+        const QByteArray value{line.mid(colon + 1).trimmed()};
+        if (key == "blocksize")
+        {
+            parsed.blockSize = value.toLongLong();
+        }
+        else if (key == "length")
+        {
+            parsed.length = value.toLongLong();
+        }
+        else if (key == "hash-lengths")
+        {
+            const QList<QByteArray> lengths{value.split(',')};
+            if (lengths.size() == 3)
+            {
+                parsed.weakBytes = lengths.at(1).toInt();
+                parsed.strongBytes = lengths.at(2).toInt();
+            }
+        }
+        else if (key == "sha-1")
+        {
+            parsed.sha1 = value.toLower();
+        }
+        else if (key == "url")
+        {
+            hasPlainUrl = true;
+        }
+        else if (key == "z-url")
+        {
+            hasCompressedUrl = true;
+        }
+    }
+
+    if (hasCompressedUrl && !hasPlainUrl)
+    {
+        *errorText = QStringLiteral("Block map only describes a compressed source");
+        return false;
+    }
+    if (parsed.blockSize < kMinBlockSize || parsed.blockSize > kMaxBlockSize || parsed.length <= 0
+        || parsed.weakBytes < 1 || parsed.weakBytes > 4 || parsed.strongBytes < 3 || parsed.strongBytes > 16
+        || parsed.sha1.size() != 40)
+    {
+        *errorText = QStringLiteral("Block map header is invalid");
+        return false;
+    }
+    if (parsed.length > kMaxFileBytes)
+    {
+        *errorText = QStringLiteral("File is too large");
+        return false;
+    }
+
+    const qint64 blocks{(parsed.length + parsed.blockSize - 1) / parsed.blockSize};
+    const qint64 recordSize{parsed.weakBytes + parsed.strongBytes};
+    const qint64 tableStart{headerEnd + 2};
+    if (data.size() - tableStart < blocks * recordSize)
+    {
+        *errorText = QStringLiteral("Block map is truncated");
+        return false;
+    }
+
+    parsed.weak.reserve(static_cast<size_t>(blocks));
+    parsed.strong.reserve(static_cast<size_t>(blocks));
+    const char *record{data.constData() + tableStart};
+    for (qint64 block = 0; block < blocks; ++block, record += recordSize)
+    {
+        quint32 weak{0};
+        for (int i = 0; i < parsed.weakBytes; ++i)
+        {
+            weak = (weak << 8) | static_cast<uchar>(record[i]);
+        }
+        parsed.weak.push_back(weak);
+        parsed.strong.emplace_back(record + parsed.weakBytes, parsed.strongBytes);
+    }
+
+    *control = std::move(parsed);
+    return true;
+}
+
+qint64 DeltaSync::blockLength(int block) const
+{
+    const qint64 start{block * control_.blockSize};
+    return qMin(control_.blockSize, control_.length - start);
+}
+
+bool DeltaSync::fillScanWindow()
+{
+    // Keep one byte past the window so it can roll; once the file runs out,
+    // pad with a block of zeros the same way the block map pads its tail.
+    const qint64 blockSize{control_.blockSize};
+    while (scanBuffer_.size() - scanPos_ <= blockSize && !scanPadded_)
+    {
+        scanBuffer_.remove(0, scanPos_);
+        scanBase_ += scanPos_;
+        scanPos_ = 0;
+
+        const QByteArray chunk{localFile_.read(kScanChunkBytes)};
+        if (chunk.isEmpty())
+        {
+            scanBuffer_.append(QByteArray(static_cast<qsizetype>(blockSize), '\0'));
+            scanPadded_ = true;
+        }
+        else
+        {
+            scanBuffer_.append(chunk);
+        }
+    }
+
+    return scanBuffer_.size() - scanPos_ >= blockSize;
+}
+
+bool DeltaSync::matchWindow(const char *window, const std::vector<int> &candidates)
+{
+    QByteArray strong{};
+    bool matched{false};
+    for (const int block : candidates)
+    {
+        if (localOffsets_[block] >= 0)
+        {
+            continue;
+        }
+
+        if (strong.isEmpty())
+        {
+            const QByteArray view{QByteArray::fromRawData(window, static_cast<qsizetype>(control_.blockSize))};
+            strong = QCryptographicHash::hash(view, QCryptographicHash::Md4).left(control_.strongBytes);
+        }
+
+        if (strong == control_.strong[block])
+        {
+            localOffsets_[block] = scanBase_ + scanPos_;
+            reused_ += blockLength(block);
+            matched = true;
+        }
+    }
+    return matched;
+}
+
+void DeltaSync::seedFromLocal()
+{
+    if (reused_ == 0)
+    {
+        fail(QStringLiteral("No blocks of the local copy can be reused"));
+        return;
+    }
+
+    // The old copy stays in place until the new one is verified, so the
+    // whole new file has to fit beside it.
+    const QStorageInfo storage{QFileInfo(tempPath_).absolutePath()};
+    if (storage.isValid() && storage.bytesAvailable() < control_.length)
+    {
+        fail(QStringLiteral("Not enough disk space for %1").arg(tempPath_));
+        return;
+    }
+
+    tempFile_.setFileName(tempPath_);
+    if (!tempFile_.open(QIODevice::ReadWrite | QIODevice::Truncate) || !tempFile_.resize(control_.length))
+    {
+        fail(QStringLiteral("Cannot create %1: %2").arg(tempPath_, tempFile_.errorString()));
+        return;
+    }
+
+    emit statusTextChanged(QStringLiteral("Copying matching blocks..."));
+    seedBlock_ = 0;
+    seedTimer_.start();
+}
+
+void DeltaSync::handleSeedStep()
+{
+    const int blocks{static_cast<int>(localOffsets_.size())};
+    qint64 budget{kScanStepBytes};
+    while (seedBlock_ < blocks && budget > 0)
+    {
+        const int block{seedBlock_++};
+        const qint64 offset{localOffsets_[block]};
+        if (offset < 0)
+        {
+            continue;
+        }
+
+        const qint64 length{blockLength(block)};
+        QByteArray data{};
+        if (localFile_.seek(offset))
+        {
+            data = localFile_.read(length);
+        }
+        // Matches in the zero padding past the local EOF read short.
+        if (data.size() < length)
+        {
+            data.append(QByteArray(static_cast<qsizetype>(length - data.size()), '\0'));
+        }
+
+        if (!tempFile_.seek(block * control_.blockSize) || tempFile_.write(data) != data.size())
+        {
+            fail(QStringLiteral("Write failed: %1").arg(tempFile_.errorString()));
+            return;
+        }
+        budget -= length;
+    }
+
+    if (seedBlock_ < blocks)
+    {
+        return;
+    }
+
+    seedTimer_.stop();
+    localFile_.close();
+    planRanges();
+    requestNextBatch();
+}
+
+void DeltaSync::planRanges()
+{
+    pending_.clear();
+    const int blocks{static_cast<int>(localOffsets_.size())};
+    for (int block = 0; block < blocks; ++block)
+    {
+        if (localOffsets_[block] >= 0)
+        {
+            continue;
+        }
+
+        const qint64 start{block * control_.blockSize};
+        const qint64 end{start + blockLength(block)};
+        if (!pending_.isEmpty() && pending_.last().end == start)
+        {
+            pending_.last().end = end;
+        }
+        else
+        {
+            pending_.append(ByteRange{start, end});
+        }
+    }
+}
+
+void DeltaSync::requestNextBatch()
+{
+    if (pending_.isEmpty())
+    {
+        complete();
+        return;
+    }
+
+    // Coalesce several missing ranges into one multi-range request, keeping
+    // each response small enough to hold in memory while it is unpacked.
+    const qint64 batchBytes{qMin(kMaxBatchBytes, MemoryBudget::instance().reserve(this, kMaxBatchBytes))};
+    QStringList specs{};
+    qint64 bytes{0};
+    while (!pending_.isEmpty() && specs.size() < kMaxRangesPerRequest && bytes < batchBytes)
+    {
+        ByteRange &next{pending_.first()};
+        const qint64 take{qMin(next.end - next.start, batchBytes - bytes)};
+        specs << QStringLiteral("%1-%2").arg(next.start).arg(next.start + take - 1);
+        bytes += take;
+        next.start += take;
+        if (next.start >= next.end)
+        {
+            pending_.removeFirst();
+        }
+    }
+
+    QNetworkRequest request{RedirectCache::instance().resolve(url_, kMaxRedirects)};
+    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+    request.setMaximumRedirectsAllowed(kMaxRedirects);
+    request.setRawHeader(QByteArrayLiteral("Range"), QByteArrayLiteral("bytes=") + specs.join(QLatin1Char(',')).toLatin1());
+    reply_ = manager_.get(request);
+    replyLimit_ = bytes + specs.size() * kPartOverheadBytes;
+    watchReply();
+    connect(reply_, &QNetworkReply::finished, this, &DeltaSync::handleRangesFinished);
+    connect(reply_, &QNetworkReply::downloadProgress, this,
+            [this](qint64 received, qint64)
+            {
+                emit progressChanged(qMin(reused_ + fetched_ + received, control_.length), control_.length);
+            });
+
+    emit statusTextChanged(QStringLiteral("Fetching %1 changed range(s)...").arg(specs.size()));
+}
+
+void DeltaSync::watchReply()
+{
+    connect(reply_, &QNetworkReply::metaDataChanged, this, &DeltaSync::handleReplyMetaData);
+    connect(reply_, &QNetworkReply::downloadProgress, this, &DeltaSync::handleReplyProgress);
+}
+
+bool DeltaSync::storeRangeReply(QNetworkReply *reply)
+{
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 206)
+    {
+        fail(QStringLiteral("Server does not support range requests"));
+        return false;
+    }
+
+    const QByteArray body{reply->readAll()};
+    const QByteArray contentType{reply->rawHeader(QByteArrayLiteral("Content-Type"))};
+    if (!contentType.toLower().startsWith("multipart/byteranges"))
+    {
+        qint64 start{0};
+        qint64 end{0};
+        if (!parseContentRange(reply->rawHeader(QByteArrayLiteral("Content-Range")), &start, &end)
+            || end - start != body.size())
+        {
+            fail(QStringLiteral("Malformed range response"));
+            return false;
+        }
+        return writeRange(start, body);
+    }
+
+    QByteArray boundary{};
+    for (const QByteArray &param : contentType.split(';'))
+    {
+        const QByteArray trimmed{param.trimmed()};
+        if (trimmed.toLower().startsWith("boundary="))
+        {
+            boundary = trimmed.mid(9);
+            if (boundary.size() >= 2 && boundary.startsWith('"') && boundary.endsWith('"'))
+            {
+                boundary = boundary.mid(1, boundary.size() - 2);
+            }
+        }
+    }
+    if (boundary.isEmpty())
+    {
+        fail(QStringLiteral("Malformed range response"));
+        return false;
+    }
+
+    const QByteArray delimiter{QByteArrayLiteral("--") + boundary};
+    qsizetype pos{body.indexOf(delimiter)};
+    while (pos >= 0)
+    {
+        pos += delimiter.size();
+        if (body.mid(pos, 2) == "--")
+        {
+            return true;
+        }
+
+        const qsizetype headersEnd{body.indexOf("\r\n\r\n", pos)};
+        qint64 start{0};
+        qint64 end{0};
+        if (headersEnd < 0
+            || !parseContentRange(headerValue(body.mid(pos, headersEnd - pos), "content-range"), &start, &end))
+        {
+            break;
+        }
+
+        const qsizetype dataStart{headersEnd + 4};
+        if (dataStart + (end - start) > body.size())
+        {
+            break;
+        }
+        if (!writeRange(start, body.mid(dataStart, end - start)))
+        {
+            return false;
+        }
+        pos = body.indexOf(delimiter, dataStart + (end - start));
+    }
+
+    fail(QStringLiteral("Malformed range response"));
+    return false;
+}
+
+bool DeltaSync::writeRange(qint64 offset, const QByteArray &data)
+{
+    if (offset < 0 || offset + data.size() > control_.length)
+    {
+        fail(QStringLiteral("Range response is outside the file"));
+        return false;
+    }
+
+    if (!tempFile_.seek(offset) || tempFile_.write(data) != data.size())
+    {
+        fail(QStringLiteral("Write failed: %1").arg(tempFile_.errorString()));
+        return false;
+    }
+
+    fetched_ += data.size();
+    emit progressChanged(reused_ + fetched_, control_.length);
+    return true;
+}
+
+void DeltaSync::complete()
+{
+    if (!tempFile_.flush() || !tempFile_.seek(0))
+    {
+        fail(QStringLiteral("Write failed: %1").arg(tempFile_.errorString()));
+        return;
+    }
+
+    sha1_.reset();
+    emit statusTextChanged(QStringLiteral("Verifying..."));
+    verifyTimer_.start();
+}
+
+void DeltaSync::handleVerifyStep()
+{
+    // Hash in slices for the same reason the scan does.
+    const QByteArray chunk{tempFile_.read(kScanStepBytes)};
+    if (!chunk.isEmpty())
+    {
+        sha1_.addData(chunk);
+        return;
+    }
+
+    verifyTimer_.stop();
+#ifndef Q_OS_WIN
+    // The data must be on disk before the rename makes it the target.
+    const bool synced{::fsync(tempFile_.handle()) == 0};
+#else
+    const bool synced{true};
+#endif
+    tempFile_.close();
+    if (sha1_.result().toHex() != control_.sha1)
+    {
+        fail(QStringLiteral("Assembled file failed SHA-1 verification"));
+        return;
+    }
+
+    QString errorText{};
+    if (!synced || !replaceFile(tempPath_, targetPath_, &errorText))
+    {
+        fail(QStringLiteral("Cannot replace %1: %2")
+                 .arg(targetPath_, synced ? errorText : QStringLiteral("failed to sync to disk")));
+        return;
+    }
+
+    active_ = false;
+    emit statusTextChanged(QStringLiteral("Completed, reused %1 KB").arg(reused_ / 1024));
+    emit finished(targetPath_, reused_, fetched_);
+}
+
+void DeltaSync::fail(const QString &errorText)
+{
+    reset();
+    QFile::remove(tempPath_);
+    emit failed(errorText);
+}
+
+void DeltaSync::reset()
+{
+    if (reply_)
+    {
+        reply_->disconnect(this);
+        reply_->abort();
+        reply_->deleteLater();
+        reply_ = nullptr;
+    }
+    MemoryBudget::instance().release(this);
+
+    scanTimer_.stop();
+    seedTimer_.stop();
+    verifyTimer_.stop();
+    localFile_.close();
+    tempFile_.close();
+    weakIndex_.clear();
+    localOffsets_.clear();
+    scanBuffer_.clear();
+    pending_.clear();
+    active_ = false;
+}
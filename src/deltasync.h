@@ -0,0 +1,108 @@
+#pragma once
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QUrl>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkReply>
+
+#include <vector>
+
+class DeltaSync : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DeltaSync(QObject *parent = nullptr);
+
+    void start(const QUrl &url, const QString &filePath, const QUrl &controlUrl = {});
+    void cancel();
+
+    bool isActive() const;
+    qint64 bytesReused() const;
+    qint64 bytesFetched() const;
+
+signals:
+    void progressChanged(qint64 bytesDone, qint64 bytesTotal);
+    void statusTextChanged(const QString &text);
+    void finished(const QString &filePath, qint64 bytesReused, qint64 bytesFetched);
+    void failed(const QString &errorText);
+
+private slots:
+    void handleControlFinished();
+    void handleScanStep();
+    void handleSeedStep();
+    void handleVerifyStep();
+    void handleRangesFinished();
+    void handleReplyMetaData();
+    void handleReplyProgress(qint64 bytesReceived, qint64 bytesTotal);
+
+private:
+    struct ControlFile
+    {
+        qint64 blockSize{0};
+        qint64 length{0};
+        int weakBytes{4};
+        int strongBytes{16};
+        QByteArray sha1{};
+        std::vector<quint32> weak{};
+        std::vector<QByteArray> strong{};
+    };
+
+    struct ByteRange
+    {
+        qint64 start{0};
+        qint64 end{0};
+    };
+
+    static bool parseControl(const QByteArray &data, ControlFile *control, QString *errorText);
+
+    qint64 blockLength(int block) const;
+    bool fillScanWindow();
+    bool matchWindow(const char *window, const std::vector<int> &candidates);
+    void seedFromLocal();
+    void planRanges();
+    void requestNextBatch();
+    void watchReply();
+    bool storeRangeReply(QNetworkReply *reply);
+    bool writeRange(qint64 offset, const QByteArray &data);
+    void complete();
+    void fail(const QString &errorText);
+    void reset();
+
+    QNetworkAccessManager manager_{};
+    QNetworkReply *reply_{nullptr};
+    qint64 replyLimit_{0};
+    QUrl url_{};
+    QString targetPath_{};
+    QString tempPath_{};
+    ControlFile control_{};
+
+    QHash<quint32, std::vector<int>> weakIndex_{};
+    std::vector<qint64> localOffsets_{};
+    QFile localFile_{};
+    QFile tempFile_{};
+    QTimer scanTimer_{};
+    QTimer seedTimer_{};
+    QTimer verifyTimer_{};
+    QByteArray scanBuffer_{};
+    qint64 scanBase_{0};
+    qsizetype scanPos_{0};
+    bool scanPadded_{false};
+    bool windowValid_{false};
+    quint16 rollA_{0};
+    quint16 rollB_{0};
+    int seedBlock_{0};
+    QCryptographicHash sha1_{QCryptographicHash::Sha1};
+
+    QList<ByteRange> pending_{};
+    qint64 reused_{0};
+    qint64 fetched_{0};
+    bool active_{false};
+};
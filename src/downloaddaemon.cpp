@@ -0,0 +1,550 @@
+#include "downloaddaemon.h"
+
+#include "memorybudget.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QStandardPaths>
+
+#include <utility>
+
+namespace
+{
+    constexpr int kDefaultMaxActive{3};
+    constexpr int kProgressIntervalMs{250};
+    constexpr qint64 kMaxLineBytes{1024 * 1024};
+    constexpr qint64 kMaxSubscriberBacklogBytes{1024 * 1024};
+
+    QJsonObject errorReply(const QString &command, const QString &text)
+    {
+        QJsonObject reply{};
+        reply.insert(QStringLiteral("reply"), command);
+        reply.insert(QStringLiteral("ok"), false);
+        reply.insert(QStringLiteral("error"), text);
+        return reply;
+    }
+
+    bool isWebUrl(const QUrl &url)
+    {
+        const QString scheme{url.scheme().toLower()};
+        return url.isValid() && (scheme == QLatin1String("http") || scheme == QLatin1String("https"));
+    }
+
+    bool isFinal(const QString &state)
+    {
+        return state == QLatin1String("finished") || state == QLatin1String("cancelled");
+    }
+
+    QJsonObject okReply(const QString &command)
+    {
+        QJsonObject reply{};
+        reply.insert(QStringLiteral("reply"), command);
+        reply.insert(QStringLiteral("ok"), true);
+        return reply;
+    }
+
+    void writeMessage(QLocalSocket *socket, const QJsonObject &message)
+    {
+        socket->write(QJsonDocument{message}.toJson(QJsonDocument::Compact) + '\n');
+    }
+}
+
+DownloadDaemon::DownloadDaemon(QObject *parent)
+    : QObject(parent), server_(this), network_(this), maxActive_(kDefaultMaxActive),
+      runId_(QString::number(QDateTime::currentMSecsSinceEpoch(), 36))
+{
+    server_.setSocketOptions(QLocalServer::UserAccessOption);
+    connect(&server_, &QLocalServer::newConnection, this, &DownloadDaemon::handleNewConnection);
+
+    progressTimer_.setInterval(kProgressIntervalMs);
+    connect(&progressTimer_, &QTimer::timeout, this, &DownloadDaemon::flushProgress);
+}
+
+QString DownloadDaemon::serverName()
+{
+    const QString user{qEnvironmentVariable("USER", qEnvironmentVariable("USERNAME"))};
+    return user.isEmpty() ? QStringLiteral("downman-daemon") : QStringLiteral("downman-daemon-%1").arg(user);
+}
+
+bool DownloadDaemon::listen(QString *errorText)
+{
+    // A socket file left behind by a crashed daemon blocks listen(); only
+    // remove it once nobody answers on it.
+    QLocalSocket probe{};
+    probe.connectToServer(serverName());
+    if (probe.waitForConnected(500))
+    {
+        *errorText = QStringLiteral("Another daemon is already listening on %1").arg(serverName());
+        return false;
+    }
+
+    QLocalServer::removeServer(serverName());
+    if (!server_.listen(serverName()))
+    {
+        *errorText = server_.errorString();
+        return false;
+    }
+
+    // Items never outlive the daemon, so checkpoints left by an earlier run
+    // cannot be resumed by anyone.
+    DownloadItem::clearSavedStates(QStringLiteral("daemon-"));
+
+    progressTimer_.start();
+    return true;
+}
+
+void DownloadDaemon::setMaxActive(int count)
+{
+    maxActive_ = qMax(1, count);
+    startQueued();
+}
+
+void DownloadDaemon::setDurabilityPolicy(DownloadItem::DurabilityPolicy policy)
+{
+    durability_ = policy;
+}
+
+void DownloadDaemon::handleNewConnection()
+{
+    while (QLocalSocket *socket{server_.nextPendingConnection()})
+    {
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]()
+                {
+                    subscribers_.remove(socket);
+                    socket->deleteLater();
+                });
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]()
+                {
+                    while (socket->canReadLine())
+                    {
+                        handleLine(socket, socket->readLine().trimmed());
+                    }
+                    if (socket->bytesAvailable() > kMaxLineBytes)
+                    {
+                        socket->abort();
+                    }
+                });
+    }
+}
+
+void DownloadDaemon::flushProgress()
+{
+    for (const int id : std::as_const(dirty_))
+    {
+        const auto it{items_.constFind(id)};
+        if (it == items_.constEnd())
+        {
+            continue;
+        }
+
+        QJsonObject event{};
+        event.insert(QStringLiteral("event"), QStringLiteral("progress"));
+        event.insert(QStringLiteral("item"), id);
+        event.insert(QStringLiteral("received"), static_cast<double>(it->received));
+        event.insert(QStringLiteral("total"), static_cast<double>(it->total));
+        event.insert(QStringLiteral("speed"), it->speed);
+        broadcast(event);
+    }
+    dirty_.clear();
+}
+
+void DownloadDaemon::handleLine(QLocalSocket *socket, const QByteArray &line)
+{
+    if (line.isEmpty())
+    {
+        return;
+    }
+
+    QJsonParseError parseError{};
+    const QJsonDocument document{QJsonDocument::fromJson(line, &parseError)};
+    if (parseError.error != QJsonParseError::NoError || !document.isObject())
+    {
+        writeMessage(socket, errorReply(QString{}, QStringLiteral("Malformed request")));
+        return;
+    }
+
+    const QJsonObject request{document.object()};
+    const QString command{request.value(QStringLiteral("cmd")).toString()};
+    const int id{request.value(QStringLiteral("item")).toInt(-1)};
+
+    if (command == QLatin1String("enqueue"))
+    {
+        writeMessage(socket, enqueue(request));
+    }
+    else if (command == QLatin1String("pause"))
+    {
+        writeMessage(socket, pause(id));
+    }
+    else if (command == QLatin1String("resume"))
+    {
+        writeMessage(socket, resume(id));
+    }
+    else if (command == QLatin1String("cancel"))
+    {
+        writeMessage(socket, cancel(id));
+    }
+    else if (command == QLatin1String("list"))
+    {
+        writeMessage(socket, list());
+    }
+    else if (command == QLatin1String("subscribe"))
+    {
+        subscribers_.insert(socket);
+        writeMessage(socket, okReply(command));
+    }
+    else if (command == QLatin1String("unsubscribe"))
+    {
+        subscribers_.remove(socket);
+        writeMessage(socket, okReply(command));
+    }
+    else
+    {
+        writeMessage(socket, errorReply(command, QStringLiteral("Unknown command")));
+    }
+}
+
+QJsonObject DownloadDaemon::enqueue(const QJsonObject &request)
+{
+    const QString command{QStringLiteral("enqueue")};
+    const QUrl url{request.value(QStringLiteral("url")).toString()};
+    if (!isWebUrl(url))
+    {
+        return errorReply(command, QStringLiteral("Invalid URL"));
+    }
+
+    QList<QUrl> mirrors{};
+    const QJsonArray mirrorValues{request.value(QStringLiteral("mirrors")).toArray()};
+    for (const auto &value : mirrorValues)
+    {
+        const QUrl mirror{value.toString()};
+        if (!isWebUrl(mirror))
+        {
+            return errorReply(command, QStringLiteral("Invalid mirror URL"));
+        }
+        mirrors.append(mirror);
+    }
+
+    QString filePath{request.value(QStringLiteral("path")).toString()};
+    if (filePath.isEmpty())
+    {
+        const QString dir{QStandardPaths::writableLocation(QStandardPaths::DownloadLocation)};
+        const QString name{QFileInfo(url.path()).fileName()};
+        filePath = (dir.isEmpty() ? QDir::homePath() : dir) + QLatin1Char('/')
+                   + (name.isEmpty() ? QStringLiteral("download.bin") : name);
+    }
+    if (!QDir::isAbsolutePath(filePath))
+    {
+        return errorReply(command, QStringLiteral("Save path must be absolute"));
+    }
+    if (!DownloadItem::isSafePath(filePath))
+    {
+        return errorReply(command, QStringLiteral("Invalid save location"));
+    }
+
+    Item item{};
+    item.id = nextId_++;
+    item.url = url;
+    item.mirrors = mirrors;
+    item.filePath = QDir::cleanPath(filePath);
+    item.expected.size = static_cast<qint64>(request.value(QStringLiteral("size")).toDouble(-1));
+    item.expected.hashType = request.value(QStringLiteral("hashType")).toString();
+    item.expected.hash = request.value(QStringLiteral("hash")).toString().toLatin1();
+    item.state = QStringLiteral("queued");
+    items_.insert(item.id, item);
+
+    QJsonObject reply{okReply(command)};
+    reply.insert(QStringLiteral("item"), item.id);
+
+    QJsonObject event{itemJson(item)};
+    event.insert(QStringLiteral("event"), QStringLiteral("state"));
+    broadcast(event);
+
+    // Start from the event loop so the caller sees the new id before any
+    // events about the transfer itself.
+    QTimer::singleShot(0, this, &DownloadDaemon::startQueued);
+    return reply;
+}
+
+QJsonObject DownloadDaemon::pause(int id)
+{
+    const QString command{QStringLiteral("pause")};
+    const auto it{items_.find(id)};
+    if (it == items_.end())
+    {
+        return errorReply(command, QStringLiteral("No such item"));
+    }
+
+    if (it->state == QLatin1String("queued"))
+    {
+        setState(id, QStringLiteral("paused"));
+    }
+    else if (it->state == QLatin1String("active"))
+    {
+        it->download->pause();
+    }
+    else
+    {
+        return errorReply(command, QStringLiteral("Item is %1").arg(it->state));
+    }
+    return okReply(command);
+}
+
+QJsonObject DownloadDaemon::resume(int id)
+{
+    const QString command{QStringLiteral("resume")};
+    const auto it{items_.find(id)};
+    if (it == items_.end())
+    {
+        return errorReply(command, QStringLiteral("No such item"));
+    }
+    if (it->state != QLatin1String("paused") && it->state != QLatin1String("failed"))
+    {
+        return errorReply(command, QStringLiteral("Item is %1").arg(it->state));
+    }
+
+    it->error.clear();
+    setState(id, QStringLiteral("queued"));
+    startQueued();
+    return okReply(command);
+}
+
+QJsonObject DownloadDaemon::cancel(int id)
+{
+    const QString command{QStringLiteral("cancel")};
+    const auto it{items_.find(id)};
+    if (it == items_.end())
+    {
+        return errorReply(command, QStringLiteral("No such item"));
+    }
+    if (it->state == QLatin1String("finished") || it->state == QLatin1String("cancelled"))
+    {
+        return errorReply(command, QStringLiteral("Item is %1").arg(it->state));
+    }
+
+    // Mark it first so the signals cancel() emits are not mistaken for a
+    // failure or a pause.
+    DownloadItem *download{it->download};
+    setState(id, QStringLiteral("cancelled"));
+    if (download)
+    {
+        download->cancel();
+    }
+    startQueued();
+    return okReply(command);
+}
+
+QJsonObject DownloadDaemon::list() const
+{
+    QJsonArray entries{};
+    for (const auto &item : items_)
+    {
+        entries.append(itemJson(item));
+    }
+
+    QJsonObject reply{okReply(QStringLiteral("list"))};
+    reply.insert(QStringLiteral("items"), entries);
+
+    const MemoryBudget &budget{MemoryBudget::instance()};
+    reply.insert(QStringLiteral("memory"), QJsonObject{{QStringLiteral("buffered"), static_cast<double>(budget.buffered())},
+                                                       {QStringLiteral("reserved"), static_cast<double>(budget.reserved())},
+                                                       {QStringLiteral("limit"), static_cast<double>(budget.globalLimit())}});
+    return reply;
+}
+
+void DownloadDaemon::startQueued()
+{
+    int active{0};
+    for (const auto &item : std::as_const(items_))
+    {
+        if (item.state == QLatin1String("active"))
+        {
+            ++active;
+        }
+    }
+
+    for (auto it{items_.begin()}; it != items_.end() && active < maxActive_; ++it)
+    {
+        if (it->state != QLatin1String("queued"))
+        {
+            continue;
+        }
+
+        const int id{it->id};
+        const bool resumable{it->download && it->download->loadSavedState().isValid()};
+        if (!it->download)
+        {
+            it->download = createDownload(id);
+        }
+
+        setState(id, QStringLiteral("active"));
+        ++active;
+        if (resumable)
+        {
+            it->download->resumeFromSaved();
+        }
+        else
+        {
+            it->download->startNew(it->url, it->filePath, it->expected);
+        }
+    }
+}
+
+DownloadItem *DownloadDaemon::createDownload(int id)
+{
+    auto *download{new DownloadItem(this)};
+    download->setNetworkManager(&network_);
+    // Ids restart at 1 with every run, so the key also names the run.
+    download->setStateKey(QStringLiteral("daemon-%1-%2").arg(runId_).arg(id));
+    download->setDurabilityPolicy(durability_);
+
+    connect(download, &DownloadItem::progressChanged, this, [this, id](qint64 received, qint64 total)
+            {
+                Item &item{items_[id]};
+                item.received = received;
+                item.total = total;
+                dirty_.insert(id);
+            });
+    connect(download, &DownloadItem::speedUpdated, this, [this, id](double speed)
+            {
+                items_[id].speed = speed;
+                dirty_.insert(id);
+            });
+    connect(download, &DownloadItem::statusTextChanged, this, [this, id](const QString &text)
+            {
+                items_[id].statusText = text;
+                QJsonObject event{};
+                event.insert(QStringLiteral("event"), QStringLiteral("status"));
+                event.insert(QStringLiteral("item"), id);
+                event.insert(QStringLiteral("text"), text);
+                broadcast(event);
+            });
+    connect(download, &DownloadItem::downloadFinished, this, [this, id](const QString &)
+            {
+                setState(id, QStringLiteral("finished"));
+                startQueued();
+            });
+    connect(download, &DownloadItem::downloadFailed, this, [this, id, download](const QString &errorText)
+            {
+                Item &item{items_[id]};
+                if (item.state != QLatin1String("active"))
+                {
+                    return;
+                }
+                item.error = errorText;
+                if (!download->isPaused() && !item.mirrors.isEmpty())
+                {
+                    // Try the next mirror from scratch; a partial file from
+                    // another server cannot be trusted to resume.
+                    item.url = item.mirrors.takeFirst();
+                    dropDownload(item);
+                    setState(id, QStringLiteral("queued"));
+                }
+                else
+                {
+                    setState(id, download->isPaused() ? QStringLiteral("paused") : QStringLiteral("failed"));
+                }
+                // Let the item unwind its own handlers before the slot is reused.
+                QTimer::singleShot(0, this, &DownloadDaemon::startQueued);
+            });
+    connect(download, &DownloadItem::paused, this, [this, id]()
+            {
+                if (items_[id].state == QLatin1String("active"))
+                {
+                    setState(id, QStringLiteral("paused"));
+                    startQueued();
+                }
+            });
+    return download;
+}
+
+void DownloadDaemon::dropDownload(Item &item)
+{
+    if (!item.download)
+    {
+        return;
+    }
+
+    // This can run from inside the item's own signals.
+    item.download->disconnect(this);
+    item.download->clearSavedState();
+    item.download->deleteLater();
+    item.download = nullptr;
+}
+
+void DownloadDaemon::removeItem(int id)
+{
+    const auto it{items_.find(id)};
+    if (it == items_.end() || !isFinal(it->state))
+    {
+        return;
+    }
+
+    dropDownload(*it);
+    dirty_.remove(id);
+    items_.erase(it);
+}
+
+void DownloadDaemon::setState(int id, const QString &state)
+{
+    Item &item{items_[id]};
+    if (item.state == state)
+    {
+        return;
+    }
+
+    item.state = state;
+    if (state != QLatin1String("active"))
+    {
+        item.speed = 0.0;
+    }
+
+    QJsonObject event{itemJson(item)};
+    event.insert(QStringLiteral("event"), QStringLiteral("state"));
+    broadcast(event);
+
+    // Subscribers have been told; nothing can be done with the item anymore,
+    // so a long-running daemon does not accumulate them.
+    if (isFinal(state))
+    {
+        QTimer::singleShot(0, this, [this, id]()
+                           { removeItem(id); });
+    }
+}
+
+void DownloadDaemon::broadcast(const QJsonObject &event)
+{
+    const QSet<QLocalSocket *> subscribers{subscribers_};
+    for (QLocalSocket *socket : subscribers)
+    {
+        // A client that stopped reading would otherwise grow our buffer
+        // without bound; it can reconnect and ask for a fresh list.
+        if (socket->bytesToWrite() > kMaxSubscriberBacklogBytes)
+        {
+            subscribers_.remove(socket);
+            socket->abort();
+            continue;
+        }
+        writeMessage(socket, event);
+    }
+}
+
+QJsonObject DownloadDaemon::itemJson(const Item &item) const
+{
+    QJsonObject json{};
+    json.insert(QStringLiteral("item"), item.id);
+    json.insert(QStringLiteral("url"), item.url.toString());
+    json.insert(QStringLiteral("path"), item.filePath);
+    json.insert(QStringLiteral("state"), item.state);
+    json.insert(QStringLiteral("status"), item.statusText);
+    json.insert(QStringLiteral("received"), static_cast<double>(item.received));
+    json.insert(QStringLiteral("total"), static_cast<double>(item.total));
+    json.insert(QStringLiteral("speed"), item.speed);
+    if (!item.error.isEmpty())
+    {
+        json.insert(QStringLiteral("error"), item.error);
+    }
+    return json;
+}
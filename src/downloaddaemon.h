@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+#include <QUrl>
+#include <QtNetwork/QLocalServer>
+#include <QtNetwork/QLocalSocket>
+#include <QtNetwork/QNetworkAccessManager>
+
+#include "downloaditem.h"
+
+class DownloadDaemon : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DownloadDaemon(QObject *parent = nullptr);
+
+    static QString serverName();
+
+    bool listen(QString *errorText);
+    void setMaxActive(int count);
+    void setDurabilityPolicy(DownloadItem::DurabilityPolicy policy);
+
+private slots:
+    void handleNewConnection();
+    void flushProgress();
+
+private:
+    struct Item
+    {
+        int id{0};
+        QUrl url{};
+        QList<QUrl> mirrors{};
+        QString filePath{};
+        DownloadItem::Expected expected{};
+        DownloadItem *download{nullptr};
+        QString state{};
+        QString statusText{};
+        QString error{};
+        qint64 received{0};
+        qint64 total{-1};
+        double speed{0.0};
+    };
+
+    void handleLine(QLocalSocket *socket, const QByteArray &line);
+    QJsonObject enqueue(const QJsonObject &request);
+    QJsonObject pause(int id);
+    QJsonObject resume(int id);
+    QJsonObject cancel(int id);
+    QJsonObject list() const;
+
+    void startQueued();
+    DownloadItem *createDownload(int id);
+    void dropDownload(Item &item);
+    void removeItem(int id);
+    void setState(int id, const QString &state);
+    void broadcast(const QJsonObject &event);
+    QJsonObject itemJson(const Item &item) const;
+
+    QLocalServer server_{};
+    QNetworkAccessManager network_{};
+    QMap<int, Item> items_{};
+    QSet<QLocalSocket *> subscribers_{};
+    QSet<int> dirty_{};
+    QTimer progressTimer_{};
+    int nextId_{1};
+    int maxActive_;
+    QString runId_;
+    DownloadItem::DurabilityPolicy durability_{DownloadItem::DurabilityPolicy::Periodic};
+};
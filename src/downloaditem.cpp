@@ -1,11 +1,20 @@
 #include "downloaditem.h"
 
+#include "checksum.h"
+#include "memorybudget.h"
+#include "redirectcache.h"
+#include "tracer.h"
+
 #include <QDir>
+#include <QFile>
 #include <QJsonDocument>
+#include <QSslConfiguration>
 #include <QJsonObject>
 #include <QVariant>
 #include <QStringList>
 
+#include <utility>
+
 namespace
 {
     const auto kUserAgent{QByteArrayLiteral(
@@ -13,6 +22,22 @@ namespace
         "(KHTML, like Gecko) Chrome/119.0 Safari/537.36")};
     constexpr qint64 kMaxDownloadBytes{1024LL * 1024LL * 1024LL}; // 1 GiB cap
     constexpr int kMaxRedirects{5};
+    constexpr qint64 kWriteBufferBytes{256 * 1024};
+    constexpr qint64 kMemoryBudgetBytes{16 * 1024 * 1024};
+    constexpr int kDrainIntervalMs{20};
+    constexpr int kFlushIntervalMs{250};
+    constexpr int kSyncIntervalMs{2000};
+    constexpr int kWarmConnectionTtlMs{30000};
+    // Requests and preconnects must agree on HTTP/2, or the warmed
+    // connection is cached under a different key and never reused.
+    constexpr bool kAllowHttp2{QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)};
+
+    QString stateDirectory()
+    {
+        const QString dir{QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)};
+        QDir{}.mkpath(dir);
+        return dir;
+    }
 }
 
 bool DownloadItem::ResumeData::isValid() const
@@ -21,30 +46,69 @@ bool DownloadItem::ResumeData::isValid() const
 }
 
 DownloadItem::DownloadItem(QObject *parent)
-    : QObject(parent), manager_(this)
+    : QObject(parent),
+      ownManager_(this),
+      traceTrack_(Tracer::instance().newTrack())
 {
+    auto fileSink{std::make_unique<FileSink>(traceTrack_)};
+    fileSink_ = fileSink.get();
+    pipeline_.addSink(std::move(fileSink), true);
+
     speedTimer_.setInterval(1000);
     connect(&speedTimer_, &QTimer::timeout, this, &DownloadItem::updateSpeed);
+    flushTimer_.setSingleShot(true);
+    flushTimer_.setInterval(kFlushIntervalMs);
+    connect(&flushTimer_, &QTimer::timeout, this, &DownloadItem::handleFlushTimer);
+    syncTimer_.setInterval(kSyncIntervalMs);
+    connect(&syncTimer_, &QTimer::timeout, this, &DownloadItem::handleSyncTimer);
+    warmTimer_.setSingleShot(true);
+    warmTimer_.setInterval(kWarmConnectionTtlMs);
+    connect(&warmTimer_, &QTimer::timeout, this, &DownloadItem::handleWarmExpired);
+    drainTimer_.setSingleShot(true);
+    drainTimer_.setInterval(kDrainIntervalMs);
+    connect(&drainTimer_, &QTimer::timeout, this, &DownloadItem::handleDrainTimer);
+}
+
+DownloadItem::~DownloadItem()
+{
+    // The reply belongs to the manager, which may be shared and outlive us.
+    if (reply_)
+    {
+        reply_->disconnect(this);
+        reply_->abort();
+        reply_->deleteLater();
+    }
+    MemoryBudget::instance().release(this);
 }
 
-void DownloadItem::startNew(const QUrl &url, const QString &filePath)
+void DownloadItem::startNew(const QUrl &url, const QString &filePath, const Expected &expected)
 {
     resetReply();
 
-    url_ = url;
+    requestedUrl_ = url;
     targetPath_ = filePath;
+    expected_ = expected;
     downloaded_ = 0;
     totalBytes_ = -1;
     paused_ = false;
     redirectCount_ = 0;
+    Tracer::instance().nameTrack(traceTrack_, QFileInfo{targetPath_}.fileName());
+    routeFromCache();
+
+    if (expected_.size > kMaxDownloadBytes)
+    {
+        emit statusTextChanged(QStringLiteral("Aborted: file too large"));
+        emit downloadFailed(QStringLiteral("Declared size exceeds limit"));
+        return;
+    }
 
     QFileInfo info{targetPath_};
     QDir dir{info.path()};
     dir.mkpath(QStringLiteral("."));
 
-    if (!openFile(true))
+    if (!openSinks(0))
     {
-        emit downloadFailed(QStringLiteral("Cannot open file for writing."));
+        emit downloadFailed(pipeline_.errorString());
         return;
     }
 
@@ -64,21 +128,23 @@ void DownloadItem::resumeFromSaved()
         return;
     }
 
-    url_ = saved.url;
+    requestedUrl_ = saved.url;
     targetPath_ = saved.filePath;
+    expected_ = saved.expected;
 
     QFileInfo info{targetPath_};
-    downloaded_ = info.exists() ? info.size() : 0;
     totalBytes_ = -1;
     paused_ = false;
     redirectCount_ = 0;
+    Tracer::instance().nameTrack(traceTrack_, info.fileName());
+    routeFromCache();
 
     QDir dir{info.path()};
     dir.mkpath(QStringLiteral("."));
 
-    if (!openFile(false))
+    if (!openSinks(saved.bytesDownloaded))
     {
-        emit downloadFailed(QStringLiteral("Cannot open file for writing."));
+        emit downloadFailed(pipeline_.errorString());
         return;
     }
 
@@ -97,15 +163,137 @@ void DownloadItem::pause()
     speedTimer_.stop();
     bytesThisSecond_ = 0;
 
+    const bool flushed{pipeline_.flush()};
+    reportDetachedSinks();
+    commitCheckpoint(true);
     persistResumeData();
     reply_->abort();
     emit speedUpdated(0.0);
+    if (!flushed)
+    {
+        emit downloadFailed(pipeline_.errorString());
+    }
     emit statusTextChanged(QStringLiteral("Paused"));
 }
 
+void DownloadItem::cancel()
+{
+    paused_ = false;
+    speedTimer_.stop();
+    bytesThisSecond_ = 0;
+    if (reply_)
+    {
+        suppressErrors_ = true;
+        reply_->abort();
+    }
+    resetReply();
+    closeSinks(false);
+    pipeline_.close();
+    clearSavedState();
+    emit speedUpdated(0.0);
+    emit statusTextChanged(QStringLiteral("Cancelled"));
+}
+
+void DownloadItem::setNetworkManager(QNetworkAccessManager *manager)
+{
+    manager_ = manager ? manager : &ownManager_;
+}
+
+void DownloadItem::setStateKey(const QString &key)
+{
+    stateKey_ = key;
+}
+
+void DownloadItem::preconnect(const QUrl &url)
+{
+    const QUrl target{RedirectCache::instance().resolve(url, kMaxRedirects)};
+    const QString scheme{target.scheme().toLower()};
+    if (target.host().isEmpty() || (scheme != QLatin1String("http") && scheme != QLatin1String("https")))
+    {
+        return;
+    }
+
+    const bool secure{scheme == QLatin1String("https")};
+    const quint16 port{static_cast<quint16>(target.port(secure ? 443 : 80))};
+    const QString key{scheme + QStringLiteral("://") + target.host() + QLatin1Char(':') + QString::number(port)};
+    if (key == warmKey_ && warmTimer_.isActive())
+    {
+        return;
+    }
+
+    if (!warmKey_.isEmpty() && !reply_ && manager_ == &ownManager_)
+    {
+        manager_->clearConnectionCache();
+    }
+    warmKey_ = key;
+    warmTimer_.start();
+
+    if (secure)
+    {
+        QSslConfiguration config{QSslConfiguration::defaultConfiguration()};
+        QList<QByteArray> protocols{QSslConfiguration::NextProtocolHttp1_1};
+        if (kAllowHttp2)
+        {
+            protocols.prepend(QSslConfiguration::ALPNProtocolHTTP2);
+        }
+        config.setAllowedNextProtocols(protocols);
+        manager_->connectToHostEncrypted(target.host(), port, config);
+    }
+    else
+    {
+        manager_->connectToHost(target.host(), port);
+    }
+
+    if (Tracer::instance().isEnabled())
+    {
+        QJsonObject args{};
+        args.insert(QStringLiteral("target"), key);
+        Tracer::instance().instant(QStringLiteral("preconnect"), QStringLiteral("network"), traceTrack_, args);
+    }
+}
+
+void DownloadItem::cancelPreconnect()
+{
+    warmTimer_.stop();
+    handleWarmExpired();
+}
+
+void DownloadItem::setDurabilityPolicy(DurabilityPolicy policy)
+{
+    fileSink_->setDurabilityPolicy(policy);
+    if (policy != DurabilityPolicy::Periodic)
+    {
+        syncTimer_.stop();
+    }
+    else if (reply_)
+    {
+        syncTimer_.start();
+    }
+}
+
+DownloadItem::DurabilityPolicy DownloadItem::durabilityPolicy() const
+{
+    return fileSink_->durabilityPolicy();
+}
+
+qint64 DownloadItem::bufferedBytes() const
+{
+    return (reply_ ? reply_->bytesAvailable() : 0) + pipeline_.pendingBytes();
+}
+
+void DownloadItem::addSink(std::unique_ptr<DataSink> sink)
+{
+    pipeline_.addSink(std::move(sink));
+}
+
+void DownloadItem::clearSinks()
+{
+    pipeline_.removeOptionalSinks();
+}
+
 DownloadItem::ResumeData DownloadItem::currentState() const
 {
-    return ResumeData{url_, targetPath_, downloaded_};
+    return ResumeData{requestedUrl_, targetPath_, downloaded_, expected_};
 }
 
 DownloadItem::ResumeData DownloadItem::loadSavedState() const
@@ -127,29 +315,17 @@ DownloadItem::ResumeData DownloadItem::loadSavedState() const
     data.url = QUrl{obj.value(QStringLiteral("url")).toString()};
     data.filePath = obj.value(QStringLiteral("filePath")).toString();
     data.bytesDownloaded = static_cast<qint64>(obj.value(QStringLiteral("bytesDownloaded")).toDouble());
+    data.expected.size = static_cast<qint64>(obj.value(QStringLiteral("expectedSize")).toDouble(-1));
+    data.expected.hashType = obj.value(QStringLiteral("hashType")).toString();
+    data.expected.hash = obj.value(QStringLiteral("hash")).toString().toLatin1();
 
-    QFileInfo pathInfo{data.filePath};
-    if (!pathInfo.isAbsolute())
-    {
-        return {};
-    }
-    const QString homeDir{QDir::homePath()};
-    const QString downloadDir{QStandardPaths::writableLocation(QStandardPaths::DownloadLocation)};
-    const QString cleanPath{QDir::cleanPath(pathInfo.absoluteFilePath())};
-    const QString cleanHome{QDir::cleanPath(homeDir)};
-    const QString cleanDownload{QDir::cleanPath(downloadDir.isEmpty() ? homeDir : downloadDir)};
-    const bool underHome{cleanPath.startsWith(cleanHome + QLatin1Char('/')) || cleanPath == cleanHome};
-    const bool underDownload{cleanPath.startsWith(cleanDownload + QLatin1Char('/')) || cleanPath == cleanDownload};
-    if (!underHome && !underDownload)
+    if (!isSafePath(data.filePath))
     {
         return {};
     }
 
     QFileInfo fileInfo{data.filePath};
-    if (fileInfo.exists())
-    {
-        data.bytesDownloaded = fileInfo.size();
-    }
+    data.bytesDownloaded = fileInfo.exists() ? qBound<qint64>(0, data.bytesDownloaded, fileInfo.size()) : 0;
 
     return data;
 }
@@ -159,6 +335,42 @@ void DownloadItem::clearSavedState()
     QFile::remove(resumeDataPath());
 }
 
+bool DownloadItem::isSafePath(const QString &path)
+{
+    // Downloads may only land below the user's home or download directory.
+    if (path.isEmpty())
+    {
+        return false;
+    }
+
+    QFileInfo info{path};
+    if (!info.isAbsolute())
+    {
+        return false;
+    }
+
+    const QString downloadDir{QStandardPaths::writableLocation(QStandardPaths::DownloadLocation)};
+    const QString homeDir{QDir::homePath()};
+    const QString cleanPath{QDir::cleanPath(info.absoluteFilePath())};
+    const QString cleanDownload{QDir::cleanPath(downloadDir.isEmpty() ? homeDir : downloadDir)};
+    const QString cleanHome{QDir::cleanPath(homeDir)};
+
+    const bool underDownload{cleanPath.startsWith(cleanDownload + QLatin1Char('/')) || cleanPath == cleanDownload};
+    const bool underHome{cleanPath.startsWith(cleanHome + QLatin1Char('/')) || cleanPath == cleanHome};
+
+    return underDownload || underHome;
+}
+
+void DownloadItem::clearSavedStates(const QString &keyPrefix)
+{
+    const QDir dir{stateDirectory()};
+    const QStringList names{dir.entryList({QStringLiteral("resume-%1*.json").arg(keyPrefix)}, QDir::Files)};
+    for (const auto &name : names)
+    {
+        QFile::remove(dir.filePath(name));
+    }
+}
+
 bool DownloadItem::isActive() const
 {
     return reply_ != nullptr;
@@ -171,35 +383,49 @@ bool DownloadItem::isPaused() const
 
 void DownloadItem::handleReadyRead()
 {
-    if (!reply_ || !file_.isOpen())
+    if (!reply_ || !fileSink_->isOpen())
     {
         return;
     }
 
-    const QByteArray data{reply_->readAll()};
-    if (data.isEmpty())
+    if (!bodyAccepted_ || reply_->attribute(QNetworkRequest::RedirectionTargetAttribute).isValid())
     {
+        reply_->readAll();
         return;
     }
 
-    if (!checkSizeLimit(data.size()))
+    // Only take as much from the reply as the sinks can absorb below the
+    // high-water mark; what is left stays in the bounded reply buffer and
+    // Qt stops reading the socket until we come back for it.
+    while (reply_ && reply_->bytesAvailable() > 0)
     {
-        reply_->abort();
-        return;
-    }
+        const qint64 room{highWater_ - pipeline_.pendingBytes()};
+        if (room <= 0)
+        {
+            if (!drainTimer_.isActive())
+            {
+                drainTimer_.start();
+            }
+            break;
+        }
 
-    if (file_.write(data) != data.size())
-    {
-        emit downloadFailed(QStringLiteral("Failed to write to file."));
-        pause();
-        return;
-    }
+        const QByteArray data{reply_->read(qMin(reply_->bytesAvailable(), room))};
+        if (data.isEmpty())
+        {
+            break;
+        }
 
-    downloaded_ += data.size();
-    bytesThisSecond_ += data.size();
-    file_.flush();
+        if (!consumeChunk(data))
+        {
+            if (reply_ && !suppressErrors_)
+            {
+                pause();
+            }
+            return;
+        }
+    }
 
-    persistResumeData();
+    MemoryBudget::instance().report(this, bufferedBytes());
 }
 
 void DownloadItem::handleDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
@@ -228,6 +454,17 @@ void DownloadItem::handleFinished()
         return;
     }
 
+    endTraceRequest();
+
+    if (retryFromOrigin_)
+    {
+        url_ = requestedUrl_;
+        redirectCount_ = 0;
+        resetReply();
+        startRequest();
+        return;
+    }
+
     const QVariant redirectTarget{reply_->attribute(QNetworkRequest::RedirectionTargetAttribute)};
     if (redirectTarget.isValid())
     {
@@ -243,6 +480,16 @@ void DownloadItem::handleFinished()
 
         ++redirectCount_;
         const QUrl redirected{url_.resolved(redirectTarget.toUrl())};
+        if (Tracer::instance().isEnabled())
+        {
+            QJsonObject args{};
+            args.insert(QStringLiteral("from"), url_.toString());
+            args.insert(QStringLiteral("to"), redirected.toString());
+            args.insert(QStringLiteral("status"), reply_->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt());
+            args.insert(QStringLiteral("hop"), redirectCount_);
+            Tracer::instance().instant(QStringLiteral("redirect"), QStringLiteral("network"), traceTrack_, args);
+        }
+        RedirectCache::instance().record(url_, redirected, *reply_);
         url_ = redirected;
         resetReply();
         startRequest();
@@ -251,43 +498,68 @@ void DownloadItem::handleFinished()
 
     if (suppressErrors_)
     {
-        if (file_.isOpen())
-        {
-            file_.flush();
-            file_.close();
-        }
+        closeSinks(false);
         emit speedUpdated(0.0);
         resetReply();
         return;
     }
 
+    if (bodyAccepted_ && reply_->error() == QNetworkReply::NoError && reply_->bytesAvailable() > 0 && fileSink_->isOpen())
+    {
+        if (!consumeChunk(reply_->readAll()))
+        {
+            closeSinks(false);
+            persistResumeData();
+            emit speedUpdated(0.0);
+            resetReply();
+            return;
+        }
+    }
+
     if (reply_->error() == QNetworkReply::NoError)
     {
-        if (file_.isOpen())
+        // Anything short of a fully written file keeps its checkpoint, so a
+        // resume refetches whatever did not reach the disk.
+        QString errorText{};
+        if (fileSink_->isOpen() && !pipeline_.flush())
         {
-            file_.flush();
-            file_.close();
+            errorText = pipeline_.errorString();
         }
+        else if (fileSink_->isOpen() && !fileSink_->truncateTo(downloaded_))
+        {
+            errorText = fileSink_->errorString();
+        }
+        else if (!closeSinks(true))
+        {
+            errorText = pipeline_.errorString();
+        }
+
+        if (!errorText.isEmpty())
+        {
+            closeSinks(false);
+            persistResumeData();
+            emit statusTextChanged(QStringLiteral("Error: ") + errorText);
+            emit downloadFailed(errorText);
+            emit speedUpdated(0.0);
+            resetReply();
+            return;
+        }
+
         clearSavedState();
-        emit statusTextChanged(QStringLiteral("Completed"));
-        emit downloadFinished(targetPath_);
+        if (verifyCompletedFile())
+        {
+            emit statusTextChanged(QStringLiteral("Completed"));
+            emit downloadFinished(targetPath_);
+        }
     }
     else if (paused_ && reply_->error() == QNetworkReply::OperationCanceledError)
     {
-        if (file_.isOpen())
-        {
-            file_.flush();
-            file_.close();
-        }
+        closeSinks(false);
         persistResumeData();
     }
     else
     {
-        if (file_.isOpen())
-        {
-            file_.flush();
-            file_.close();
-        }
+        closeSinks(false);
     }
 
     emit speedUpdated(0.0);
@@ -308,11 +580,40 @@ void DownloadItem::handleError(QNetworkReply::NetworkError error)
         return;
     }
 
+    if (cachedRoute_ && !paused_ && !suppressErrors_ && error != QNetworkReply::OperationCanceledError)
+    {
+        // The remembered hop may have gone stale; start over from the
+        // original URL once before reporting the failure. Aborts we caused
+        // ourselves are not route failures and never retry. Nothing the
+        // stale hop sent is kept, so the retry starts where this request did.
+        RedirectCache::instance().invalidate(requestedUrl_);
+        cachedRoute_ = false;
+        if (fileSink_->rewindTo(startOffset_))
+        {
+            if (downloaded_ > startOffset_)
+            {
+                // Streams already saw those bytes and cannot take them back.
+                pipeline_.removeOptionalSinks();
+                emit statusTextChanged(QStringLiteral("Output detached: redirect went stale"));
+            }
+            downloaded_ = startOffset_;
+            retryFromOrigin_ = true;
+            commitCheckpoint(false);
+            return;
+        }
+    }
+
     speedTimer_.stop();
     bytesThisSecond_ = 0;
     emit speedUpdated(0.0);
     emit statusTextChanged(QStringLiteral("Error: ") + reply_->errorString());
     emit downloadFailed(reply_->errorString());
+    if (!pipeline_.flush())
+    {
+        emit statusTextChanged(QStringLiteral("Error: ") + pipeline_.errorString());
+    }
+    reportDetachedSinks();
+    commitCheckpoint(true);
     persistResumeData();
 }
 
@@ -330,6 +631,9 @@ void DownloadItem::handleSslErrors(const QList<QSslError> &errors)
     emit downloadFailed(combined);
     if (reply_)
     {
+        // The failure is already reported; keep the abort from being
+        // retried or reported a second time.
+        suppressErrors_ = true;
         reply_->abort();
     }
 }
@@ -341,15 +645,32 @@ void DownloadItem::handleMetaDataChanged()
         return;
     }
 
+    if (phase_ != QLatin1String("body"))
+    {
+        beginTracePhase(QStringLiteral("body"));
+    }
+
+    // Redirect and error pages must never reach the file; Qt only reports
+    // an HTTP error once the whole body has been read.
     const int status{reply_->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt()};
+    bodyAccepted_ = status < 300;
+    if (!bodyAccepted_)
+    {
+        return;
+    }
+
     if (status == 200 && startOffset_ > 0)
     {
-        if (file_.isOpen())
+        Tracer::instance().instant(QStringLiteral("range ignored"), QStringLiteral("network"), traceTrack_);
+        startOffset_ = 0;
+        if (!openSinks(0))
         {
-            file_.resize(0);
+            emit statusTextChanged(QStringLiteral("Error: ") + pipeline_.errorString());
+            emit downloadFailed(pipeline_.errorString());
+            suppressErrors_ = true;
+            reply_->abort();
+            return;
         }
-        downloaded_ = 0;
-        startOffset_ = 0;
         persistResumeData();
     }
 
@@ -371,12 +692,68 @@ void DownloadItem::updateSpeed()
 {
     const double speed{static_cast<double>(bytesThisSecond_) / 1024.0};
     emit speedUpdated(speed);
+    emit bufferedBytesChanged(bufferedBytes());
     bytesThisSecond_ = 0;
 }
 
+void DownloadItem::handleFlushTimer()
+{
+    const bool flushed{pipeline_.flush()};
+    reportDetachedSinks();
+    if (!flushed)
+    {
+        emit downloadFailed(pipeline_.errorString());
+        pause();
+        return;
+    }
+
+    commitCheckpoint(false);
+    if (pipeline_.pendingBytes() > 0)
+    {
+        flushTimer_.start();
+    }
+}
+
+void DownloadItem::handleSyncTimer()
+{
+    if (fileSink_->isOpen())
+    {
+        commitCheckpoint(true);
+    }
+}
+
+void DownloadItem::handleDrainTimer()
+{
+    const bool flushed{pipeline_.flush()};
+    reportDetachedSinks();
+    if (!flushed)
+    {
+        emit downloadFailed(pipeline_.errorString());
+        pause();
+        return;
+    }
+
+    handleReadyRead();
+}
+
+void DownloadItem::handleWarmExpired()
+{
+    if (warmKey_.isEmpty())
+    {
+        return;
+    }
+
+    warmKey_.clear();
+    // A shared manager's idle connections belong to other downloads too.
+    if (!reply_ && manager_ == &ownManager_)
+    {
+        manager_->clearConnectionCache();
+    }
+}
+
 void DownloadItem::startRequest()
 {
-    if (!file_.isOpen())
+    if (!fileSink_->isOpen())
     {
         emit downloadFailed(QStringLiteral("File is not open."));
         return;
@@ -386,10 +763,19 @@ void DownloadItem::startRequest()
     bytesThisSecond_ = 0;
     paused_ = false;
     suppressErrors_ = false;
+    bodyAccepted_ = false;
+
+    warmTimer_.stop();
+    warmKey_.clear();
+
+    requestStartUs_ = Tracer::instance().nowUs();
+    phase_.clear();
+    beginTracePhase(QStringLiteral("queue+dns"));
 
     QNetworkRequest request{url_};
     request.setHeader(QNetworkRequest::UserAgentHeader, kUserAgent);
     request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::ManualRedirectPolicy);
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, kAllowHttp2);
 
     if (downloaded_ > 0)
     {
@@ -397,7 +783,13 @@ void DownloadItem::startRequest()
         request.setRawHeader(QByteArrayLiteral("Range"), rangeHeader);
     }
 
-    reply_ = manager_.get(request);
+    const qint64 granted{MemoryBudget::instance().reserve(this, kMemoryBudgetBytes)};
+    const qint64 readBufferSize{granted / 2};
+    highWater_ = granted - readBufferSize;
+    fileSink_->setBufferSize(qMin(kWriteBufferBytes, highWater_ / 2));
+
+    reply_ = manager_->get(request);
+    reply_->setReadBufferSize(readBufferSize);
 
     connect(reply_, &QNetworkReply::readyRead, this, &DownloadItem::handleReadyRead);
     connect(reply_, &QNetworkReply::downloadProgress, this, &DownloadItem::handleDownloadProgress);
@@ -406,37 +798,113 @@ void DownloadItem::startRequest()
     connect(reply_, &QNetworkReply::metaDataChanged, this, &DownloadItem::handleMetaDataChanged);
     connect(reply_, &QNetworkReply::sslErrors, this, &DownloadItem::handleSslErrors);
 
+    if (fileSink_->durabilityPolicy() == DurabilityPolicy::Periodic)
+    {
+        syncTimer_.start();
+    }
+
+    if (Tracer::instance().isEnabled())
+    {
+        const bool secure{url_.scheme() == QLatin1String("https")};
+#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
+        connect(reply_, &QNetworkReply::socketStartedConnecting, this, [this, secure]()
+                { beginTracePhase(secure ? QStringLiteral("tcp+tls connect") : QStringLiteral("tcp connect")); });
+        connect(reply_, &QNetworkReply::requestSent, this, [this]()
+                { beginTracePhase(QStringLiteral("ttfb")); });
+#endif
+        if (secure)
+        {
+            connect(reply_, &QNetworkReply::encrypted, this, [this]()
+                    { beginTracePhase(QStringLiteral("send request")); });
+        }
+    }
+
     speedTimer_.start();
 }
 
-bool DownloadItem::openFile(bool truncate)
+bool DownloadItem::openSinks(qint64 offset)
 {
-    if (file_.isOpen())
+    fileSink_->setPath(targetPath_);
+    // Without a hash the declared size is the only completeness check, so a
+    // preallocated partial file must not already have that size.
+    fileSink_->setReservedSize(expected_.hash.isEmpty() ? -1 : expected_.size);
+    lastCheckpoint_ = -1;
+
+    const bool opened{pipeline_.open(offset)};
+    reportDetachedSinks();
+    if (!opened)
     {
-        file_.close();
+        return false;
     }
 
-    file_.setFileName(targetPath_);
-    QIODevice::OpenMode mode{QIODevice::WriteOnly};
-    mode |= truncate ? QIODevice::Truncate : QIODevice::Append;
+    downloaded_ = offset;
+    return true;
+}
 
-    if (!file_.open(mode))
+bool DownloadItem::consumeChunk(const QByteArray &data)
+{
+    if (!checkSizeLimit(data.size()))
     {
         return false;
     }
 
-    if (!truncate && downloaded_ > 0)
+    downloaded_ += data.size();
+    bytesThisSecond_ += data.size();
+
+    const bool written{pipeline_.write(data)};
+    reportDetachedSinks();
+    if (!written)
     {
-        file_.seek(downloaded_);
+        emit downloadFailed(pipeline_.errorString());
+        return false;
     }
-    else
+
+    commitCheckpoint(false);
+    if (pipeline_.pendingBytes() > 0 && !flushTimer_.isActive())
     {
-        downloaded_ = 0;
+        flushTimer_.start();
     }
-
     return true;
 }
 
+void DownloadItem::commitCheckpoint(bool finalSync)
+{
+    fileSink_->sync(finalSync);
+    if (fileSink_->checkpointBytes() != lastCheckpoint_)
+    {
+        lastCheckpoint_ = fileSink_->checkpointBytes();
+        persistResumeData();
+    }
+}
+
+bool DownloadItem::closeSinks(bool finished)
+{
+    syncTimer_.stop();
+    flushTimer_.stop();
+    drainTimer_.stop();
+    if (!fileSink_->isOpen())
+    {
+        return true;
+    }
+
+    // Streaming consumers stay attached across a pause so a resume can
+    // continue feeding them; only a complete download ends their stream.
+    const bool flushed{pipeline_.flush()};
+    reportDetachedSinks();
+    commitCheckpoint(true);
+    const bool closed{finished && flushed ? pipeline_.close() : fileSink_->close()};
+    return flushed && closed;
+}
+
+void DownloadItem::reportDetachedSinks()
+{
+    const QStringList detached{pipeline_.takeDetached()};
+    for (const auto &sink : detached)
+    {
+        emit statusTextChanged(QStringLiteral("Output detached: ") + sink);
+    }
+}
+
 void DownloadItem::resetReply()
 {
     if (reply_)
@@ -445,15 +913,27 @@ void DownloadItem::resetReply()
         reply_->deleteLater();
         reply_ = nullptr;
     }
+    drainTimer_.stop();
+    MemoryBudget::instance().release(this);
     suppressErrors_ = false;
+    retryFromOrigin_ = false;
 }
 
 void DownloadItem::persistResumeData() const
 {
     QJsonObject obj{};
-    obj.insert(QStringLiteral("url"), url_.toString());
+    obj.insert(QStringLiteral("url"), requestedUrl_.toString());
     obj.insert(QStringLiteral("filePath"), targetPath_);
-    obj.insert(QStringLiteral("bytesDownloaded"), static_cast<double>(downloaded_));
+    obj.insert(QStringLiteral("bytesDownloaded"), static_cast<double>(fileSink_->checkpointBytes()));
+    if (expected_.size >= 0)
+    {
+        obj.insert(QStringLiteral("expectedSize"), static_cast<double>(expected_.size));
+    }
+    if (!expected_.hash.isEmpty())
+    {
+        obj.insert(QStringLiteral("hashType"), expected_.hashType);
+        obj.insert(QStringLiteral("hash"), QString::fromLatin1(expected_.hash));
+    }
 
     const QString path{resumeDataPath()};
     QFile infoFile{path};
@@ -468,9 +948,12 @@ void DownloadItem::persistResumeData() const
 
 QString DownloadItem::resumeDataPath() const
 {
-    const QString dir{QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)};
-    QDir{}.mkpath(dir);
-    return dir + QStringLiteral("/resume.json");
+    const QString dir{stateDirectory()};
+    if (stateKey_.isEmpty())
+    {
+        return dir + QStringLiteral("/resume.json");
+    }
+    return dir + QStringLiteral("/resume-%1.json").arg(stateKey_);
 }
 
 bool DownloadItem::checkSizeLimit(qint64 nextChunkBytes)
@@ -495,3 +978,87 @@ bool DownloadItem::checkSizeLimit(qint64 nextChunkBytes)
 
     return true;
 }
+
+bool DownloadItem::verifyCompletedFile()
+{
+    if (expected_.size >= 0 && downloaded_ != expected_.size)
+    {
+        emit statusTextChanged(QStringLiteral("Error: size mismatch"));
+        emit downloadFailed(QStringLiteral("Downloaded size does not match the declared size"));
+        return false;
+    }
+
+    if (expected_.hash.isEmpty())
+    {
+        return true;
+    }
+
+    emit statusTextChanged(QStringLiteral("Verifying..."));
+    if (!Checksum::verifyFile(targetPath_, expected_.size, expected_.hashType, expected_.hash))
+    {
+        emit statusTextChanged(QStringLiteral("Error: checksum mismatch"));
+        emit downloadFailed(QStringLiteral("Checksum mismatch"));
+        return false;
+    }
+
+    return true;
+}
+
+void DownloadItem::routeFromCache()
+{
+    int hops{0};
+    url_ = RedirectCache::instance().resolve(requestedUrl_, kMaxRedirects, &hops);
+    cachedRoute_ = hops > 0;
+
+    if (cachedRoute_ && Tracer::instance().isEnabled())
+    {
+        QJsonObject args{};
+        args.insert(QStringLiteral("from"), requestedUrl_.toString());
+        args.insert(QStringLiteral("to"), url_.toString());
+        args.insert(QStringLiteral("hops"), hops);
+        Tracer::instance().instant(QStringLiteral("redirect cache hit"), QStringLiteral("network"), traceTrack_, args);
+    }
+}
+
+void DownloadItem::beginTracePhase(const QString &phase)
+{
+    Tracer &tracer{Tracer::instance()};
+    if (!tracer.isEnabled())
+    {
+        return;
+    }
+
+    const qint64 now{tracer.nowUs()};
+    if (!phase_.isEmpty())
+    {
+        tracer.complete(phase_, QStringLiteral("network"), traceTrack_, phaseStartUs_, now);
+    }
+    phase_ = phase;
+    phaseStartUs_ = now;
+}
+
+void DownloadItem::endTraceRequest()
+{
+    Tracer &tracer{Tracer::instance()};
+    if (!tracer.isEnabled() || !reply_)
+    {
+        return;
+    }
+
+    const qint64 now{tracer.nowUs()};
+    if (!phase_.isEmpty())
+    {
+        tracer.complete(phase_, QStringLiteral("network"), traceTrack_, phaseStartUs_, now);
+        phase_.clear();
+    }
+
+    QJsonObject args{};
+    args.insert(QStringLiteral("url"), url_.toString());
+    args.insert(QStringLiteral("status"), reply_->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt());
+    args.insert(QStringLiteral("offset"), static_cast<double>(startOffset_));
+    if (reply_->error() != QNetworkReply::NoError)
+    {
+        args.insert(QStringLiteral("error"), reply_->errorString());
+    }
+    tracer.complete(QStringLiteral("request"), QStringLiteral("request"), traceTrack_, requestStartUs_, now, args);
+}
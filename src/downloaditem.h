@@ -1,7 +1,6 @@
 #pragma once
 
 #include <QByteArray>
-#include <QFile>
 #include <QFileInfo>
 #include <QtNetwork/QNetworkAccessManager>
 #include <QtNetwork/QNetworkReply>
@@ -14,29 +13,61 @@
 
 #include <QObject>
 
+#include <memory>
+
+#include "datasink.h"
+#include "filesink.h"
+
 class DownloadItem : public QObject
 {
     Q_OBJECT
 
 public:
+    using DurabilityPolicy = FileSink::DurabilityPolicy;
+
+    struct Expected
+    {
+        qint64 size{-1};
+        QString hashType{};
+        QByteArray hash{};
+    };
+
     struct ResumeData
     {
         QUrl url{};
         QString filePath{};
         qint64 bytesDownloaded{};
+        Expected expected{};
 
         bool isValid() const;
     };
 
     explicit DownloadItem(QObject *parent = nullptr);
+    ~DownloadItem() override;
 
-    void startNew(const QUrl &url, const QString &filePath);
+    void startNew(const QUrl &url, const QString &filePath, const Expected &expected = {});
     void resumeFromSaved();
     void pause();
+    void cancel();
+
+    void preconnect(const QUrl &url);
+    void cancelPreconnect();
+
+    void setNetworkManager(QNetworkAccessManager *manager);
+    void setStateKey(const QString &key);
+
+    void setDurabilityPolicy(DurabilityPolicy policy);
+    DurabilityPolicy durabilityPolicy() const;
+    qint64 bufferedBytes() const;
+
+    void addSink(std::unique_ptr<DataSink> sink);
+    void clearSinks();
 
     ResumeData currentState() const;
     ResumeData loadSavedState() const;
     void clearSavedState();
+    static void clearSavedStates(const QString &keyPrefix);
+    static bool isSafePath(const QString &path);
 
     bool isActive() const;
     bool isPaused() const;
@@ -48,6 +79,7 @@ signals:
     void downloadFinished(const QString &filePath);
     void downloadFailed(const QString &errorText);
     void paused();
+    void bufferedBytesChanged(qint64 bytes);
 
 private slots:
     void handleReadyRead();
@@ -57,27 +89,61 @@ private slots:
     void handleMetaDataChanged();
     void handleSslErrors(const QList<QSslError> &errors);
     void updateSpeed();
+    void handleFlushTimer();
+    void handleSyncTimer();
+    void handleWarmExpired();
+    void handleDrainTimer();
 
 private:
     void startRequest();
-    bool openFile(bool truncate);
+    bool openSinks(qint64 offset);
+    bool consumeChunk(const QByteArray &data);
+    void commitCheckpoint(bool finalSync);
+    bool closeSinks(bool finished);
+    void reportDetachedSinks();
     void resetReply();
     void persistResumeData() const;
     QString resumeDataPath() const;
     bool checkSizeLimit(qint64 nextChunkBytes);
+    bool verifyCompletedFile();
+    void routeFromCache();
+    void beginTracePhase(const QString &phase);
+    void endTraceRequest();
 
-    QNetworkAccessManager manager_{};
+    QNetworkAccessManager ownManager_{};
+    QNetworkAccessManager *manager_{&ownManager_};
     QNetworkReply *reply_{nullptr};
-    QFile file_{};
+    TeeSink pipeline_{};
+    FileSink *fileSink_{nullptr};
+    QUrl requestedUrl_{};
     QUrl url_{};
     QString targetPath_;
+    QString stateKey_{};
+    Expected expected_{};
     qint64 downloaded_{0};
     qint64 startOffset_{0};
     qint64 totalBytes_{-1};
     bool paused_{false};
     int redirectCount_{0};
+    bool cachedRoute_{false};
+    bool retryFromOrigin_{false};
     bool suppressErrors_{false};
+    bool bodyAccepted_{false};
 
     QTimer speedTimer_{};
     qint64 bytesThisSecond_{0};
+
+    qint64 lastCheckpoint_{-1};
+    qint64 highWater_{0};
+    QTimer drainTimer_{};
+    QTimer flushTimer_{};
+    QTimer syncTimer_{};
+
+    QString warmKey_{};
+    QTimer warmTimer_{};
+
+    int traceTrack_{0};
+    qint64 requestStartUs_{0};
+    qint64 phaseStartUs_{0};
+    QString phase_{};
 };
@@ -0,0 +1,250 @@
+#include "downloadlistmodel.h"
+
+#include <QLocale>
+#include <QVector>
+
+#include <algorithm>
+
+namespace
+{
+    constexpr int kFlushIntervalMs{250};
+}
+
+DownloadListModel::DownloadListModel(QObject *parent)
+    : QAbstractTableModel(parent)
+{
+    flushTimer_.setSingleShot(true);
+    flushTimer_.setInterval(kFlushIntervalMs);
+    connect(&flushTimer_, &QTimer::timeout, this, &DownloadListModel::flushChanges);
+}
+
+int DownloadListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : committedRows_;
+}
+
+int DownloadListModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant DownloadListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= committedRows_)
+    {
+        return {};
+    }
+
+    const Entry &entry{entries_[static_cast<size_t>(index.row())]};
+    if (role == Qt::ToolTipRole && index.column() == NameColumn)
+    {
+        return entry.url.toString();
+    }
+
+    if (role == SortRole)
+    {
+        switch (index.column())
+        {
+        case NameColumn:
+            return entry.name;
+        case ProgressColumn:
+            return percentOf(entry);
+        case SizeColumn:
+            return entry.total;
+        case SpeedColumn:
+            return entry.speed;
+        case StateColumn:
+            return entry.state;
+        default:
+            return {};
+        }
+    }
+
+    if (role != Qt::DisplayRole)
+    {
+        return {};
+    }
+
+    switch (index.column())
+    {
+    case NameColumn:
+        return entry.name;
+    case ProgressColumn:
+        // The delegate draws this as a bar; -1 means the size is unknown.
+        return percentOf(entry);
+    case SizeColumn:
+        return entry.total >= 0 ? QLocale{}.formattedDataSize(entry.total) : QString{};
+    case SpeedColumn:
+        return entry.speed > 0.0 ? tr("%1 KB/s").arg(QString::number(entry.speed, 'f', 1)) : QString{};
+    case StateColumn:
+        return entry.state;
+    default:
+        return {};
+    }
+}
+
+QVariant DownloadListModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+    {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    switch (section)
+    {
+    case NameColumn:
+        return tr("Name");
+    case ProgressColumn:
+        return tr("Progress");
+    case SizeColumn:
+        return tr("Size");
+    case SpeedColumn:
+        return tr("Speed");
+    case StateColumn:
+        return tr("State");
+    default:
+        return {};
+    }
+}
+
+bool DownloadListModel::contains(int id) const
+{
+    return rows_.contains(id);
+}
+
+QString DownloadListModel::state(int id) const
+{
+    const auto it{rows_.constFind(id)};
+    return it == rows_.constEnd() ? QString{} : entries_[static_cast<size_t>(*it)].state;
+}
+
+void DownloadListModel::addItem(int id, const QString &name, const QUrl &url, const QString &state)
+{
+    if (Entry *entry{entryFor(id)})
+    {
+        entry->name = name;
+        entry->url = url;
+        entry->state = state;
+        markChanged(id);
+        return;
+    }
+
+    // New rows are announced with the next flush, so importing thousands
+    // of entries costs one insert notification instead of one per row.
+    rows_.insert(id, static_cast<int>(entries_.size()));
+    entries_.push_back(Entry{id, name, url, 0, -1, 0.0, state});
+    scheduleFlush();
+}
+
+void DownloadListModel::setProgress(int id, qint64 bytesReceived, qint64 bytesTotal)
+{
+    if (Entry *entry{entryFor(id)})
+    {
+        entry->received = bytesReceived;
+        entry->total = bytesTotal;
+        markChanged(id);
+    }
+}
+
+void DownloadListModel::setSpeed(int id, double kilobytesPerSecond)
+{
+    if (Entry *entry{entryFor(id)})
+    {
+        entry->speed = kilobytesPerSecond;
+        markChanged(id);
+    }
+}
+
+void DownloadListModel::setState(int id, const QString &state)
+{
+    if (Entry *entry{entryFor(id)})
+    {
+        entry->state = state;
+        if (state != QLatin1String("active"))
+        {
+            entry->speed = 0.0;
+        }
+        markChanged(id);
+    }
+}
+
+void DownloadListModel::clear()
+{
+    beginResetModel();
+    entries_.clear();
+    rows_.clear();
+    changedRows_.clear();
+    committedRows_ = 0;
+    endResetModel();
+}
+
+void DownloadListModel::flushChanges()
+{
+    const int total{static_cast<int>(entries_.size())};
+    if (committedRows_ < total)
+    {
+        beginInsertRows({}, committedRows_, total - 1);
+        committedRows_ = total;
+        endInsertRows();
+    }
+
+    if (changedRows_.isEmpty())
+    {
+        return;
+    }
+
+    std::vector<int> rows(changedRows_.cbegin(), changedRows_.cend());
+    changedRows_.clear();
+    std::sort(rows.begin(), rows.end());
+
+    // One dataChanged per run of adjacent rows keeps the view and the proxy
+    // from re-examining every row on each progress tick.
+    const QVector<int> roles{Qt::DisplayRole, SortRole};
+    size_t first{0};
+    for (size_t i = 1; i <= rows.size(); ++i)
+    {
+        if (i < rows.size() && rows[i] == rows[i - 1] + 1)
+        {
+            continue;
+        }
+        emit dataChanged(index(rows[first], NameColumn), index(rows[i - 1], StateColumn), roles);
+        first = i;
+    }
+}
+
+DownloadListModel::Entry *DownloadListModel::entryFor(int id)
+{
+    const auto it{rows_.constFind(id)};
+    return it == rows_.constEnd() ? nullptr : &entries_[static_cast<size_t>(*it)];
+}
+
+void DownloadListModel::markChanged(int id)
+{
+    const int row{rows_.value(id)};
+    if (row < committedRows_)
+    {
+        changedRows_.insert(row);
+    }
+    scheduleFlush();
+}
+
+void DownloadListModel::scheduleFlush()
+{
+    if (!flushTimer_.isActive())
+    {
+        flushTimer_.start();
+    }
+}
+
+int DownloadListModel::percentOf(const Entry &entry)
+{
+    if (entry.state == QLatin1String("finished"))
+    {
+        return 100;
+    }
+    if (entry.total <= 0)
+    {
+        return -1;
+    }
+    return static_cast<int>((entry.received * 100) / entry.total);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+#include <QUrl>
+
+#include <vector>
+
+class DownloadListModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column
+    {
+        NameColumn,
+        ProgressColumn,
+        SizeColumn,
+        SpeedColumn,
+        StateColumn,
+        ColumnCount
+    };
+
+    static constexpr int SortRole{Qt::UserRole};
+
+    explicit DownloadListModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = {}) const override;
+    int columnCount(const QModelIndex &parent = {}) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    bool contains(int id) const;
+    QString state(int id) const;
+    void addItem(int id, const QString &name, const QUrl &url, const QString &state);
+    void setProgress(int id, qint64 bytesReceived, qint64 bytesTotal);
+    void setSpeed(int id, double kilobytesPerSecond);
+    void setState(int id, const QString &state);
+    void clear();
+
+private slots:
+    void flushChanges();
+
+private:
+    struct Entry
+    {
+        int id{0};
+        QString name{};
+        QUrl url{};
+        qint64 received{0};
+        qint64 total{-1};
+        double speed{0.0};
+        QString state{};
+    };
+
+    Entry *entryFor(int id);
+    void markChanged(int id);
+    void scheduleFlush();
+    static int percentOf(const Entry &entry);
+
+    std::vector<Entry> entries_{};
+    QHash<int, int> rows_{};
+    QSet<int> changedRows_{};
+    int committedRows_{0};
+    QTimer flushTimer_{};
+};
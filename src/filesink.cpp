@@ -0,0 +1,241 @@
+#include "filesink.h"
+
+#include "tracer.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonObject>
+#include <QtGlobal>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr qint64 kDefaultBufferBytes{256 * 1024};
+}
+
+bool FileSink::syncToDisk(QFileDevice &file)
+{
+    if (!file.flush())
+    {
+        return false;
+    }
+#if defined(Q_OS_WIN)
+    return ::_commit(file.handle()) == 0;
+#elif defined(Q_OS_DARWIN)
+    return ::fsync(file.handle()) == 0;
+#else
+    return ::fdatasync(file.handle()) == 0;
+#endif
+}
+
+FileSink::FileSink(int traceTrack)
+    : bufferLimit_(kDefaultBufferBytes), traceTrack_(traceTrack)
+{
+}
+
+void FileSink::setPath(const QString &path)
+{
+    file_.setFileName(path);
+}
+
+QString FileSink::path() const
+{
+    return file_.fileName();
+}
+
+void FileSink::setReservedSize(qint64 bytes)
+{
+    reservedSize_ = bytes;
+}
+
+void FileSink::setBufferSize(qint64 bytes)
+{
+    bufferLimit_ = qMax<qint64>(0, bytes);
+}
+
+void FileSink::setDurabilityPolicy(DurabilityPolicy policy)
+{
+    durability_ = policy;
+}
+
+FileSink::DurabilityPolicy FileSink::durabilityPolicy() const
+{
+    return durability_;
+}
+
+QString FileSink::name() const
+{
+    return QFileInfo{file_.fileName()}.fileName();
+}
+
+bool FileSink::open(qint64 offset)
+{
+    buffer_.resize(0);
+    if (file_.isOpen())
+    {
+        file_.close();
+    }
+
+    QDir{}.mkpath(QFileInfo{file_.fileName()}.path());
+
+    QIODevice::OpenMode mode{QIODevice::ReadWrite};
+    if (offset == 0)
+    {
+        mode |= QIODevice::Truncate;
+    }
+
+    if (!file_.open(mode))
+    {
+        return fail(QStringLiteral("Cannot open file for writing."));
+    }
+
+    if (offset > file_.size())
+    {
+        file_.close();
+        return fail(QStringLiteral("Resume offset is past the end of the file."));
+    }
+
+    // Preallocate the declared size up front; otherwise drop any tail past
+    // the last checkpoint so it is fetched again rather than trusted.
+    const qint64 reserved{reservedSize_ > 0 ? qMax(reservedSize_, offset) : offset};
+    if ((file_.size() != reserved && !file_.resize(reserved)) || !file_.seek(offset))
+    {
+        file_.close();
+        return fail(QStringLiteral("Cannot open file for writing."));
+    }
+
+    buffer_.reserve(bufferLimit_);
+    written_ = offset;
+    durable_ = offset;
+    return true;
+}
+
+bool FileSink::write(const QByteArray &data)
+{
+    if (!file_.isOpen())
+    {
+        return fail(QStringLiteral("File is not open."));
+    }
+
+    buffer_.append(data);
+    if (buffer_.size() < bufferLimit_)
+    {
+        return true;
+    }
+
+    return flush();
+}
+
+bool FileSink::flush()
+{
+    if (buffer_.isEmpty() || !file_.isOpen())
+    {
+        return true;
+    }
+
+    Tracer &tracer{Tracer::instance()};
+    const qint64 writeStartUs{tracer.nowUs()};
+    const qint64 size{buffer_.size()};
+    if (file_.write(buffer_) != size || !file_.flush())
+    {
+        buffer_.resize(0);
+        file_.seek(written_);
+        return fail(QStringLiteral("Failed to write to file."));
+    }
+    buffer_.resize(0);
+    written_ += size;
+
+    if (tracer.isEnabled())
+    {
+        QJsonObject args{};
+        args.insert(QStringLiteral("bytes"), static_cast<double>(size));
+        tracer.complete(QStringLiteral("write"), QStringLiteral("disk"), traceTrack_, writeStartUs, tracer.nowUs(), args);
+    }
+    return true;
+}
+
+bool FileSink::close()
+{
+    if (!file_.isOpen())
+    {
+        return true;
+    }
+
+    const bool flushed{flush()};
+    const bool synced{sync(true)};
+    file_.close();
+    if (flushed && !synced)
+    {
+        return fail(QStringLiteral("Failed to sync file to disk."));
+    }
+    return flushed;
+}
+
+qint64 FileSink::pendingBytes() const
+{
+    return buffer_.size();
+}
+
+bool FileSink::isOpen() const
+{
+    return file_.isOpen();
+}
+
+bool FileSink::sync(bool finalSync)
+{
+    // A checkpoint never claims more than the policy has made durable, so a
+    // resume after a crash refetches anything the disk may have lost.
+    const bool needed{finalSync ? durability_ != DurabilityPolicy::None
+                                : durability_ == DurabilityPolicy::Checkpoint};
+    if (!needed || durable_ >= written_ || !file_.isOpen())
+    {
+        return true;
+    }
+
+    Tracer &tracer{Tracer::instance()};
+    const qint64 syncStartUs{tracer.nowUs()};
+    const bool synced{syncToDisk(file_)};
+    if (synced)
+    {
+        durable_ = written_;
+    }
+    tracer.complete(QStringLiteral("sync"), QStringLiteral("disk"), traceTrack_, syncStartUs, tracer.nowUs());
+    return synced;
+}
+
+bool FileSink::truncateTo(qint64 length)
+{
+    if (!flush())
+    {
+        return false;
+    }
+    if (file_.size() > length && !file_.resize(length))
+    {
+        return fail(QStringLiteral("Cannot trim preallocated file."));
+    }
+    return true;
+}
+
+bool FileSink::rewindTo(qint64 offset)
+{
+    // Unflushed data is dropped and flushed data past the offset is left to
+    // be overwritten; the checkpoint never claims any of it.
+    buffer_.resize(0);
+    if (!file_.isOpen() || offset < 0 || offset > written_ || !file_.seek(offset))
+    {
+        return fail(QStringLiteral("Cannot rewind file."));
+    }
+    written_ = offset;
+    durable_ = qMin(durable_, offset);
+    return true;
+}
+
+qint64 FileSink::checkpointBytes() const
+{
+    return durability_ == DurabilityPolicy::None ? written_ : durable_;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QFileDevice>
+#include <QString>
+
+#include "datasink.h"
+
+class FileSink : public DataSink
+{
+public:
+    // Checkpoints only claim bytes a sync has made durable, except under
+    // None, which skips syncing and trusts everything written to the OS.
+    enum class DurabilityPolicy
+    {
+        None,
+        Periodic,
+        Checkpoint,
+        OnFinish
+    };
+
+    explicit FileSink(int traceTrack = 0);
+
+    void setPath(const QString &path);
+    QString path() const;
+    void setReservedSize(qint64 bytes);
+    void setBufferSize(qint64 bytes);
+    void setDurabilityPolicy(DurabilityPolicy policy);
+    DurabilityPolicy durabilityPolicy() const;
+
+    QString name() const override;
+    bool open(qint64 offset) override;
+    bool write(const QByteArray &data) override;
+    bool flush() override;
+    bool close() override;
+    qint64 pendingBytes() const override;
+
+    bool isOpen() const;
+    bool sync(bool finalSync);
+    bool truncateTo(qint64 length);
+    bool rewindTo(qint64 offset);
+    qint64 checkpointBytes() const;
+
+    static bool syncToDisk(QFileDevice &file);
+
+private:
+    QFile file_{};
+    QByteArray buffer_{};
+    qint64 bufferLimit_;
+    qint64 reservedSize_{-1};
+    qint64 written_{0};
+    qint64 durable_{0};
+    DurabilityPolicy durability_{DurabilityPolicy::Periodic};
+    int traceTrack_{0};
+};
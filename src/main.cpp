@@ -1,13 +1,177 @@
+#include "daemonclient.h"
+#include "downloaddaemon.h"
 #include "mainwindow.h"
+#include "memorybudget.h"
+#include "tracer.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+
+#include <csignal>
+#include <cstring>
+#include <memory>
+
+namespace
+{
+    bool hasFlag(int argc, char *argv[], const char *flag)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            if (std::strcmp(argv[i], flag) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool parseDurability(const QString &value, DownloadItem::DurabilityPolicy *policy)
+    {
+        using Policy = DownloadItem::DurabilityPolicy;
+        if (value == QLatin1String("none"))
+        {
+            *policy = Policy::None;
+        }
+        else if (value == QLatin1String("periodic"))
+        {
+            *policy = Policy::Periodic;
+        }
+        else if (value == QLatin1String("checkpoint"))
+        {
+            *policy = Policy::Checkpoint;
+        }
+        else if (value == QLatin1String("finish"))
+        {
+            *policy = Policy::OnFinish;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    int runDaemon(QCoreApplication &app, const QCommandLineParser &parser, const QCommandLineOption &maxActiveOption,
+                  DownloadItem::DurabilityPolicy durability)
+    {
+        DownloadDaemon daemon{};
+        daemon.setDurabilityPolicy(durability);
+        if (parser.isSet(maxActiveOption))
+        {
+            daemon.setMaxActive(parser.value(maxActiveOption).toInt());
+        }
+
+        QString errorText{};
+        if (!daemon.listen(&errorText))
+        {
+            qCritical().noquote() << errorText;
+            return 1;
+        }
+
+        const int status{app.exec()};
+        Tracer::instance().flush();
+        return status;
+    }
+}
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
+#ifndef Q_OS_WIN
+    // A --tee reader that goes away must surface as EPIPE on its sink, not
+    // terminate the whole process.
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    // The daemon has no windows, so it must not require a display.
+    std::unique_ptr<QCoreApplication> app{};
+    if (hasFlag(argc, argv, "--daemon"))
+    {
+        app = std::make_unique<QCoreApplication>(argc, argv);
+    }
+    else
+    {
+        app = std::make_unique<QApplication>(argc, argv);
+    }
+
+    QCommandLineParser parser{};
+    parser.addHelpOption();
+    const QCommandLineOption teeOption{QStringLiteral("tee"),
+                                       QStringLiteral("Also stream downloaded data to <target> (\"-\" for stdout, or a named pipe)."),
+                                       QStringLiteral("target")};
+    parser.addOption(teeOption);
+    const QCommandLineOption memoryLimitOption{QStringLiteral("memory-limit"),
+                                               QStringLiteral("Cap memory used for buffering across all downloads at <MiB>."),
+                                               QStringLiteral("MiB")};
+    parser.addOption(memoryLimitOption);
+    const QCommandLineOption daemonOption{QStringLiteral("daemon"),
+                                          QStringLiteral("Run headless and accept downloads over the local control socket.")};
+    parser.addOption(daemonOption);
+    const QCommandLineOption maxActiveOption{QStringLiteral("max-active"),
+                                             QStringLiteral("Number of transfers the daemon runs at once."),
+                                             QStringLiteral("count")};
+    parser.addOption(maxActiveOption);
+    const QCommandLineOption attachOption{QStringLiteral("attach"),
+                                          QStringLiteral("Hand downloads to a running daemon instead of fetching in this window.")};
+    parser.addOption(attachOption);
+    const QCommandLineOption durabilityOption{QStringLiteral("durability"),
+                                              QStringLiteral("When written data is synced to disk: none, periodic, checkpoint or finish."),
+                                              QStringLiteral("policy"),
+                                              QStringLiteral("periodic")};
+    parser.addOption(durabilityOption);
+    const QCommandLineOption deltaOption{QStringLiteral("delta"),
+                                         QStringLiteral("Refresh existing files block by block when the server publishes a .zsync map.")};
+    parser.addOption(deltaOption);
+    parser.process(*app);
+
+    DownloadItem::DurabilityPolicy durability{DownloadItem::DurabilityPolicy::Periodic};
+    if (!parseDurability(parser.value(durabilityOption), &durability))
+    {
+        parser.showHelp(1);
+    }
+
+    if (parser.isSet(memoryLimitOption))
+    {
+        bool ok{false};
+        const qint64 mebibytes{parser.value(memoryLimitOption).toLongLong(&ok)};
+        if (!ok || mebibytes <= 0)
+        {
+            parser.showHelp(1);
+        }
+        MemoryBudget::instance().setGlobalLimit(mebibytes * 1024 * 1024);
+    }
+
+    const QString tracePath{qEnvironmentVariable("DOWNMAN_TRACE")};
+    if (!tracePath.isEmpty())
+    {
+        Tracer::instance().enable(tracePath);
+    }
+
+    if (parser.isSet(daemonOption))
+    {
+        return runDaemon(*app, parser, maxActiveOption, durability);
+    }
 
+    DaemonClient client{};
     MainWindow w{};
+    w.setTeeTargets(parser.values(teeOption));
+    w.setDurabilityPolicy(durability);
+    w.setDeltaUpdates(parser.isSet(deltaOption));
+    if (parser.isSet(attachOption))
+    {
+        if (client.connectToDaemon())
+        {
+            w.attachToDaemon(&client);
+        }
+        else
+        {
+            qWarning().noquote() << QStringLiteral("No download daemon is running; downloading in this window.");
+        }
+    }
     w.show();
 
-    return a.exec();
+    const int status{app->exec()};
+    Tracer::instance().flush();
+    return status;
 }
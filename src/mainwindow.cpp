@@ -1,11 +1,28 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
+#include "checksum.h"
+#include "memorybudget.h"
+#include "pipesink.h"
+#include "progressdelegate.h"
+
 #include <QDir>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QHeaderView>
 #include <QStandardPaths>
 #include <QStringList>
+#include <QTimer>
+
+#include <memory>
+#include <utility>
+
+namespace
+{
+    constexpr int kPreconnectDelayMs{400};
+    constexpr int kBulkMinFiles{32};
+    constexpr qint64 kBulkMaxFileBytes{1024 * 1024};
+}
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent), ui(new Ui::MainWindow)
@@ -22,6 +39,58 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
+void MainWindow::setTeeTargets(const QStringList &targets)
+{
+    teeTargets_ = targets;
+}
+
+void MainWindow::setDurabilityPolicy(DownloadItem::DurabilityPolicy policy)
+{
+    downloader_.setDurabilityPolicy(policy);
+    bulk_.setDurabilityPolicy(policy);
+}
+
+void MainWindow::setDeltaUpdates(bool enabled)
+{
+    deltaUpdates_ = enabled;
+}
+
+void MainWindow::attachToDaemon(DaemonClient *client)
+{
+    daemon_ = client;
+    daemonItem_ = -1;
+    downloader_.cancelPreconnect();
+    hasSavedState_ = false;
+
+    connect(daemon_, &DaemonClient::enqueued, this, &MainWindow::handleDaemonEnqueued);
+    connect(daemon_, &DaemonClient::requestFailed, this, [this](const QString &, const QString &errorText)
+            { handleFailure(errorText); });
+    connect(daemon_, &DaemonClient::itemStateChanged, this, &MainWindow::handleDaemonState);
+    connect(daemon_, &DaemonClient::itemProgress, this, &MainWindow::handleDaemonProgress);
+    connect(daemon_, &DaemonClient::itemStatusText, this, &MainWindow::handleDaemonStatus);
+    connect(daemon_, &DaemonClient::connectionLost, this, &MainWindow::handleDaemonLost);
+    connect(daemon_, &DaemonClient::listReceived, this, [this](const QJsonArray &items)
+            {
+                for (const auto &value : items)
+                {
+                    const QJsonObject item{value.toObject()};
+                    const int id{item.value(QStringLiteral("item")).toInt()};
+                    const QString path{item.value(QStringLiteral("path")).toString()};
+                    listModel_.addItem(id, QFileInfo(path).fileName(), QUrl{item.value(QStringLiteral("url")).toString()},
+                                       item.value(QStringLiteral("state")).toString());
+                    listModel_.setProgress(id,
+                                           static_cast<qint64>(item.value(QStringLiteral("received")).toDouble()),
+                                           static_cast<qint64>(item.value(QStringLiteral("total")).toDouble(-1)));
+                }
+            });
+    daemon_->subscribe();
+    daemon_->requestList();
+
+    lastStatus_ = tr("Attached to download daemon");
+    refreshPauseResumeState();
+    updateStatusLabel();
+}
+
 void MainWindow::setupUiDefaults()
 {
     ui->downloadInput->setPlaceholderText(tr("Enter URL..."));
@@ -30,28 +99,78 @@ void MainWindow::setupUiDefaults()
     ui->progressBar->setValue(0);
     ui->statusLabel->setText(tr("Idle"));
     ui->pauseResumeButton->setEnabled(false);
+
+    preconnectTimer_.setSingleShot(true);
+    preconnectTimer_.setInterval(kPreconnectDelayMs);
+
+    setupDownloadList();
+}
+
+void MainWindow::setupDownloadList()
+{
+    listProxy_.setSourceModel(&listModel_);
+    listProxy_.setSortRole(DownloadListModel::SortRole);
+    listProxy_.setFilterCaseSensitivity(Qt::CaseInsensitive);
+    listProxy_.setFilterKeyColumn(DownloadListModel::NameColumn);
+
+    // Fixed row heights let the view map scroll position to rows without
+    // measuring them, so only the visible rows are ever laid out or painted.
+    QTableView *view{ui->downloadList};
+    view->setModel(&listProxy_);
+    view->setItemDelegateForColumn(DownloadListModel::ProgressColumn, new ProgressDelegate(view));
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    view->setWordWrap(false);
+    view->setSortingEnabled(true);
+    view->sortByColumn(DownloadListModel::NameColumn, Qt::AscendingOrder);
+    view->verticalHeader()->hide();
+    view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    view->verticalHeader()->setDefaultSectionSize(view->fontMetrics().height() + 8);
+    view->horizontalHeader()->setSectionResizeMode(DownloadListModel::NameColumn, QHeaderView::Stretch);
+
+    ui->filterInput->setPlaceholderText(tr("Filter downloads..."));
+    ui->filterInput->setClearButtonEnabled(true);
+    connect(ui->filterInput, &QLineEdit::textChanged, &listProxy_, &QSortFilterProxyModel::setFilterFixedString);
 }
 
 void MainWindow::connectSignals()
 {
     connect(ui->buttonDownload, &QPushButton::clicked, this, &MainWindow::handleDownload);
+    connect(ui->importButton, &QPushButton::clicked, this, &MainWindow::handleImport);
     connect(ui->pauseResumeButton, &QPushButton::clicked, this, &MainWindow::handlePauseResume);
     connect(ui->downloadInput, &QLineEdit::returnPressed, this, &MainWindow::handleDownload);
+    connect(ui->downloadInput, &QLineEdit::textEdited, &preconnectTimer_, qOverload<>(&QTimer::start));
+    connect(&preconnectTimer_, &QTimer::timeout, this, &MainWindow::handlePreconnect);
 
     connect(&downloader_, &DownloadItem::progressChanged, this, &MainWindow::updateProgress);
     connect(&downloader_, &DownloadItem::speedUpdated, this, &MainWindow::updateSpeed);
+    connect(&downloader_, &DownloadItem::bufferedBytesChanged, this, &MainWindow::updateBuffered);
     connect(&downloader_, &DownloadItem::statusTextChanged, this, &MainWindow::updateStatusText);
     connect(&downloader_, &DownloadItem::downloadFinished, this, &MainWindow::handleFinished);
     connect(&downloader_, &DownloadItem::downloadFailed, this, &MainWindow::handleFailure);
     connect(&downloader_, &DownloadItem::paused, this, &MainWindow::handlePaused);
+
+    connect(&deltaSync_, &DeltaSync::progressChanged, this, &MainWindow::updateProgress);
+    connect(&deltaSync_, &DeltaSync::statusTextChanged, this, &MainWindow::updateStatusText);
+    connect(&deltaSync_, &DeltaSync::finished, this, &MainWindow::handleDeltaFinished);
+    connect(&deltaSync_, &DeltaSync::failed, this, &MainWindow::handleDeltaFailed);
+
+    connect(&bulk_, &BulkDownloader::fileFinished, this, [this](int index, const QString &)
+            { handleBulkFileDone(index, QStringLiteral("finished")); });
+    connect(&bulk_, &BulkDownloader::fileSkipped, this, [this](int index, const QString &)
+            { handleBulkFileDone(index, QStringLiteral("skipped")); });
+    connect(&bulk_, &BulkDownloader::fileFailed, this, &MainWindow::handleBulkFailed);
+    connect(&bulk_, &BulkDownloader::progressChanged, this, &MainWindow::handleBulkProgress);
+    connect(&bulk_, &BulkDownloader::finished, this, &MainWindow::handleBulkFinished);
 }
 
 void MainWindow::handleDownload()
 {
-    if (downloader_.isActive())
+    if (isBusy())
     {
         return;
     }
+    localItem_ = 0;
 
     const QString text{ui->downloadInput->text().trimmed()};
     const QUrl url{QUrl::fromUserInput(text)};
@@ -72,16 +191,176 @@ void MainWindow::handleDownload()
     lastStatus_ = tr("Starting...");
     updateStatusLabel();
 
+    if (daemon_)
+    {
+        daemonItem_ = -1;
+        daemonState_.clear();
+        daemon_->enqueue(url, savePath);
+        return;
+    }
+
     ui->buttonDownload->setEnabled(false);
     ui->pauseResumeButton->setEnabled(true);
     ui->pauseResumeButton->setText(tr("Pause"));
 
-    downloader_.startNew(url, savePath);
-    hasSavedState_ = true;
+    localItem_ = addLocalListItem(url, savePath, QStringLiteral("active"));
+    startTransfer(url, savePath);
+}
+
+void MainWindow::handleImport()
+{
+    if (isBusy())
+    {
+        return;
+    }
+
+    const QString defaultDir{QStandardPaths::writableLocation(QStandardPaths::DownloadLocation)};
+    const QString baseDir{defaultDir.isEmpty() ? QDir::homePath() : defaultDir};
+
+    const QString manifestPath{QFileDialog::getOpenFileName(
+        this,
+        tr("Import Manifest"),
+        baseDir,
+        tr("Manifests (*.meta4 *.metalink *.json *.csv);;All Files (*)"))};
+    if (manifestPath.isEmpty())
+    {
+        return;
+    }
+
+    QString errorText{};
+    const QList<ManifestEntry> entries{Manifest::load(manifestPath, &errorText)};
+    if (entries.isEmpty())
+    {
+        handleFailure(errorText.isEmpty() ? tr("Manifest lists no files") : errorText);
+        return;
+    }
+
+    const QString targetDir{QFileDialog::getExistingDirectory(this, tr("Save Files To"), baseDir)};
+    if (targetDir.isEmpty())
+    {
+        return;
+    }
+    if (!DownloadItem::isSafePath(targetDir))
+    {
+        handleFailure(tr("Invalid save location"));
+        return;
+    }
+
+    if (daemon_)
+    {
+        const DownloadItem::ResumeData saved{downloader_.loadSavedState()};
+        int queued{0};
+        int skipped{0};
+        for (const auto &entry : entries)
+        {
+            const QString path{manifestTargetPath(targetDir, entry.fileName)};
+            if (path.isEmpty() || entry.urls.isEmpty())
+            {
+                continue;
+            }
+            const bool interrupted{saved.isValid() && QDir::cleanPath(saved.filePath) == QDir::cleanPath(path)};
+            if (!interrupted && isAlreadyComplete(path, entry))
+            {
+                ++skipped;
+                continue;
+            }
+
+            daemon_->enqueue(entry.urls.first(), path, DownloadItem::Expected{entry.size, entry.hashType, entry.hash},
+                             entry.urls.mid(1));
+            ++queued;
+        }
+        lastStatus_ = tr("Queued %1 of %2 files on the daemon, %3 already present")
+                          .arg(queued)
+                          .arg(entries.size())
+                          .arg(skipped);
+        updateStatusLabel();
+        return;
+    }
+
+    batchCompleted_ = 0;
+    batchSkipped_ = 0;
+    batchFailed_ = 0;
+    QList<QueuedDownload> jobs{};
+    for (const auto &entry : entries)
+    {
+        const QString path{manifestTargetPath(targetDir, entry.fileName)};
+        if (path.isEmpty())
+        {
+            ++batchFailed_;
+            continue;
+        }
+        jobs.append(QueuedDownload{entry, path, 0, addLocalListItem(entry.urls.value(0), path, QStringLiteral("queued"))});
+    }
+
+    if (suitsBulkMode(jobs))
+    {
+        startBulk(jobs);
+        return;
+    }
+
+    queue_.append(jobs);
+    startNextQueued();
 }
 
 void MainWindow::handlePauseResume()
 {
+    if (daemon_)
+    {
+        if (daemonState_ == QLatin1String("paused") || daemonState_ == QLatin1String("failed"))
+        {
+            daemon_->resume(daemonItem_);
+        }
+        else if (daemonItem_ >= 0)
+        {
+            daemon_->pause(daemonItem_);
+        }
+        return;
+    }
+
+    // A delta update cannot be resumed part way, so pausing drops it and
+    // resuming fetches the file in full like any other download.
+    if (deltaSync_.isActive())
+    {
+        deltaSync_.cancel();
+        deltaPaused_ = true;
+        setLocalListState(QStringLiteral("paused"));
+        lastStatus_ = tr("Paused");
+        lastSpeed_ = 0.0;
+        ui->buttonDownload->setEnabled(true);
+        refreshPauseResumeState();
+        updateStatusLabel();
+        return;
+    }
+
+    // The bulk checkpoint keeps every file not yet stored, including those
+    // waiting for a mirror retry, so pausing simply stops the pass.
+    if (bulk_.isActive())
+    {
+        for (const auto &job : std::as_const(bulkJobs_))
+        {
+            const QString state{listModel_.state(job.listId)};
+            if (state == QLatin1String("queued") || state == QLatin1String("active"))
+            {
+                listModel_.setState(job.listId, QStringLiteral("paused"));
+            }
+        }
+        queue_.clear();
+        bulk_.cancel();
+        lastStatus_ = tr("Paused");
+        updateStatusLabel();
+        return;
+    }
+
+    if (deltaPaused_)
+    {
+        ui->buttonDownload->setEnabled(false);
+        lastStatus_ = tr("Resuming...");
+        updateStatusLabel();
+        setLocalListState(QStringLiteral("active"));
+        startFullDownloadAfterDelta();
+        return;
+    }
+
     if (downloader_.isActive())
     {
         if (downloader_.isPaused())
@@ -90,6 +369,7 @@ void MainWindow::handlePauseResume()
             ui->pauseResumeButton->setText(tr("Pause"));
             lastStatus_ = tr("Resuming...");
             updateStatusLabel();
+            setLocalListState(QStringLiteral("active"));
             downloader_.resumeFromSaved();
         }
         else
@@ -106,14 +386,23 @@ void MainWindow::handlePauseResume()
         ui->pauseResumeButton->setText(tr("Pause"));
         lastStatus_ = tr("Resuming...");
         updateStatusLabel();
+        setLocalListState(QStringLiteral("active"));
         downloader_.resumeFromSaved();
     }
+    else if (hasBulkCheckpoint_ && !isBusy())
+    {
+        resumeBulkCheckpoint();
+    }
 }
 
 void MainWindow::updateProgress(qint64 bytesReceived, qint64 bytesTotal)
 {
     lastReceived_ = bytesReceived;
     lastTotal_ = bytesTotal;
+    if (!daemon_ && localItem_ != 0)
+    {
+        listModel_.setProgress(localItem_, bytesReceived, bytesTotal);
+    }
 
     if (bytesTotal > 0)
     {
@@ -132,6 +421,16 @@ void MainWindow::updateProgress(qint64 bytesReceived, qint64 bytesTotal)
 void MainWindow::updateSpeed(double kbps)
 {
     lastSpeed_ = kbps;
+    if (!daemon_ && localItem_ != 0)
+    {
+        listModel_.setSpeed(localItem_, kbps);
+    }
+    updateStatusLabel();
+}
+
+void MainWindow::updateBuffered(qint64 bytes)
+{
+    lastBuffered_ = bytes;
     updateStatusLabel();
 }
 
@@ -143,6 +442,8 @@ void MainWindow::updateStatusText(const QString &text)
 
 void MainWindow::handleFinished(const QString &filePath)
 {
+    setLocalListState(QStringLiteral("finished"));
+    localItem_ = 0;
     lastStatus_ = tr("Completed: %1").arg(QFileInfo(filePath).fileName());
     lastSpeed_ = 0.0;
     ui->buttonDownload->setEnabled(true);
@@ -152,20 +453,34 @@ void MainWindow::handleFinished(const QString &filePath)
     ui->progressBar->setValue(100);
     hasSavedState_ = false;
     updateStatusLabel();
+
+    if (currentJob_)
+    {
+        ++batchCompleted_;
+        currentJob_.reset();
+        scheduleAdvance();
+    }
 }
 
 void MainWindow::handleFailure(const QString &errorText)
 {
+    setLocalListState(downloader_.isPaused() ? QStringLiteral("paused") : QStringLiteral("failed"));
     lastStatus_ = tr("Failed: %1").arg(errorText);
     lastSpeed_ = 0.0;
     ui->buttonDownload->setEnabled(true);
     hasSavedState_ = downloader_.loadSavedState().isValid();
     refreshPauseResumeState();
     updateStatusLabel();
+
+    if (currentJob_ && !downloader_.isPaused())
+    {
+        scheduleAdvance();
+    }
 }
 
 void MainWindow::handlePaused()
 {
+    setLocalListState(QStringLiteral("paused"));
     lastStatus_ = tr("Paused");
     lastSpeed_ = 0.0;
     hasSavedState_ = downloader_.loadSavedState().isValid();
@@ -176,6 +491,22 @@ void MainWindow::handlePaused()
 
 void MainWindow::refreshPauseResumeState()
 {
+    if (daemon_)
+    {
+        const bool resumable{daemonState_ == QLatin1String("paused") || daemonState_ == QLatin1String("failed")};
+        const bool pausable{daemonState_ == QLatin1String("queued") || daemonState_ == QLatin1String("active")};
+        ui->pauseResumeButton->setEnabled(daemonItem_ >= 0 && (resumable || pausable));
+        ui->pauseResumeButton->setText(resumable ? tr("Resume") : tr("Pause"));
+        return;
+    }
+
+    if (deltaSync_.isActive() || bulk_.isActive())
+    {
+        ui->pauseResumeButton->setEnabled(true);
+        ui->pauseResumeButton->setText(tr("Pause"));
+        return;
+    }
+
     if (downloader_.isActive())
     {
         ui->pauseResumeButton->setEnabled(true);
@@ -183,7 +514,7 @@ void MainWindow::refreshPauseResumeState()
         return;
     }
 
-    ui->pauseResumeButton->setEnabled(hasSavedState_);
+    ui->pauseResumeButton->setEnabled(hasSavedState_ || hasBulkCheckpoint_ || deltaPaused_);
     ui->pauseResumeButton->setText(tr("Resume"));
 }
 
@@ -203,6 +534,16 @@ void MainWindow::updateStatusLabel()
     }
 
     parts << tr("Speed: %1 KB/s").arg(QString::number(lastSpeed_, 'f', 1));
+    if (downloader_.isActive())
+    {
+        parts << tr("Buffered: %1 KB").arg(lastBuffered_ / 1024);
+    }
+    // Transfers in a daemon are accounted in that process, not this one.
+    const MemoryBudget &budget{MemoryBudget::instance()};
+    if (!daemon_ && budget.reserved() > 0)
+    {
+        parts << tr("Total buffered: %1 KB of %2 MiB").arg(budget.buffered() / 1024).arg(budget.globalLimit() / (1024 * 1024));
+    }
     ui->statusLabel->setText(parts.join(QStringLiteral(" | ")));
 }
 
@@ -224,7 +565,7 @@ QString MainWindow::chooseSavePath(const QUrl &url)
         tr("Save File"),
         (defaultDir.isEmpty() ? QDir::homePath() : defaultDir) + QStringLiteral("/") + suggestedName)};
 
-    if (!target.isEmpty() && !isSafePath(target))
+    if (!target.isEmpty() && !DownloadItem::isSafePath(target))
     {
         handleFailure(tr("Invalid save location"));
         return {};
@@ -236,10 +577,15 @@ QString MainWindow::chooseSavePath(const QUrl &url)
 void MainWindow::loadSavedState()
 {
     const DownloadItem::ResumeData saved{downloader_.loadSavedState()};
-    hasSavedState_ = saved.isValid() && isSafePath(saved.filePath);
+    hasSavedState_ = saved.isValid() && DownloadItem::isSafePath(saved.filePath);
     if (!hasSavedState_)
     {
         downloader_.clearSavedState();
+        hasBulkCheckpoint_ = !BulkDownloader::loadCheckpoint().isEmpty();
+        if (hasBulkCheckpoint_)
+        {
+            lastStatus_ = tr("Unfinished bulk batch can be resumed");
+        }
         refreshPauseResumeState();
         return;
     }
@@ -262,27 +608,456 @@ void MainWindow::resetProgress()
     ui->progressBar->setValue(0);
 }
 
-bool MainWindow::isSafePath(const QString &path) const
+QString MainWindow::manifestTargetPath(const QString &dir, const QString &fileName) const
 {
-    if (path.isEmpty())
+    if (fileName.isEmpty() || QDir::isAbsolutePath(fileName))
+    {
+        return {};
+    }
+
+    const QString cleanDir{QDir::cleanPath(dir)};
+    const QString candidate{QDir::cleanPath(cleanDir + QLatin1Char('/') + fileName)};
+    if (!candidate.startsWith(cleanDir + QLatin1Char('/')) || !DownloadItem::isSafePath(candidate))
+    {
+        return {};
+    }
+
+    return candidate;
+}
+
+void MainWindow::scheduleAdvance()
+{
+    // Failures can be reported more than once and from inside DownloadItem's
+    // own handlers, so move on to the next job from the event loop instead.
+    if (advancePending_)
+    {
+        return;
+    }
+    advancePending_ = true;
+    QTimer::singleShot(0, this, &MainWindow::advanceQueue);
+}
+
+void MainWindow::advanceQueue()
+{
+    advancePending_ = false;
+
+    if (currentJob_)
+    {
+        QueuedDownload job{*currentJob_};
+        currentJob_.reset();
+        if (++job.mirrorIndex < job.entry.urls.size())
+        {
+            beginJob(job);
+            return;
+        }
+        ++batchFailed_;
+    }
+
+    startNextQueued();
+}
+
+void MainWindow::startNextQueued()
+{
+    const DownloadItem::ResumeData saved{downloader_.loadSavedState()};
+    while (!queue_.isEmpty())
+    {
+        const QueuedDownload job{queue_.takeFirst()};
+        const bool interrupted{saved.isValid() && QDir::cleanPath(saved.filePath) == QDir::cleanPath(job.filePath)};
+        if (!interrupted && isAlreadyComplete(job.filePath, job.entry))
+        {
+            ++batchSkipped_;
+            listModel_.setState(job.listId, QStringLiteral("skipped"));
+            continue;
+        }
+
+        beginJob(job, interrupted);
+        return;
+    }
+
+    // The bulk checkpoint still lists the files handed to the queue; keep it
+    // if any of them failed again so the batch can be resumed.
+    if (bulkRetriesPending_)
+    {
+        bulkRetriesPending_ = false;
+        if (batchFailed_ == 0)
+        {
+            BulkDownloader::clearCheckpoint();
+        }
+        hasBulkCheckpoint_ = !BulkDownloader::loadCheckpoint().isEmpty();
+    }
+
+    localItem_ = 0;
+    lastStatus_ = tr("Batch complete: %1 downloaded, %2 skipped, %3 failed")
+                      .arg(batchCompleted_)
+                      .arg(batchSkipped_)
+                      .arg(batchFailed_);
+    ui->buttonDownload->setEnabled(true);
+    refreshPauseResumeState();
+    updateStatusLabel();
+}
+
+bool MainWindow::isAlreadyComplete(const QString &filePath, const ManifestEntry &entry) const
+{
+    // A size-only match cannot tell a finished file from an interrupted,
+    // preallocated one, so only a hash lets an entry be skipped.
+    return !entry.hash.isEmpty() && Checksum::verifyFile(filePath, entry.size, entry.hashType, entry.hash);
+}
+
+void MainWindow::beginJob(const QueuedDownload &job, bool resumeSaved)
+{
+    currentJob_ = job;
+    localItem_ = job.listId;
+    listModel_.setState(localItem_, QStringLiteral("active"));
+    currentUrl_ = job.entry.urls.at(job.mirrorIndex);
+    ui->downloadInput->setText(currentUrl_.toString());
+
+    resetProgress();
+    lastStatus_ = tr("Starting %1 (%2 queued)...").arg(job.entry.fileName).arg(queue_.size());
+    updateStatusLabel();
+
+    ui->buttonDownload->setEnabled(false);
+    ui->pauseResumeButton->setEnabled(true);
+    ui->pauseResumeButton->setText(tr("Pause"));
+
+    if (resumeSaved)
+    {
+        // Continue from the checkpoint instead of truncating what is on disk.
+        attachTeeSinks();
+        downloader_.resumeFromSaved();
+        hasSavedState_ = true;
+    }
+    else
+    {
+        const DownloadItem::Expected expected{job.entry.size, job.entry.hashType, job.entry.hash};
+        startTransfer(currentUrl_, job.filePath, expected);
+    }
+
+    if (!daemon_ && !queue_.isEmpty())
+    {
+        downloader_.preconnect(queue_.first().entry.urls.value(0));
+    }
+}
+
+void MainWindow::handlePreconnect()
+{
+    // An attached window never fetches through its own manager, so a warm
+    // connection there would only cost a wasted handshake.
+    if (daemon_ || isBusy())
+    {
+        return;
+    }
+
+    const QUrl url{QUrl::fromUserInput(ui->downloadInput->text().trimmed())};
+    const QString host{url.host()};
+    const bool plausibleHost{host.contains(QLatin1Char('.')) || host == QLatin1String("localhost")};
+    if (!url.isValid() || url.isRelative() || !plausibleHost)
+    {
+        downloader_.cancelPreconnect();
+        return;
+    }
+
+    downloader_.preconnect(url);
+}
+
+void MainWindow::handleDeltaFinished(const QString &filePath, qint64 bytesReused, qint64 bytesFetched)
+{
+    // The block map only proves the file matches what the server holds now;
+    // the manifest's expectation still has to hold for the result.
+    const bool hasExpectation{deltaExpected_.size >= 0 || !deltaExpected_.hash.isEmpty()};
+    if (hasExpectation && !Checksum::verifyFile(filePath, deltaExpected_.size, deltaExpected_.hashType, deltaExpected_.hash))
+    {
+        handleDeltaFailed(tr("result does not match the expected checksum"));
+        return;
+    }
+
+    handleFinished(filePath);
+    lastStatus_ = tr("Updated %1: reused %2 KB, fetched %3 KB")
+                      .arg(QFileInfo(filePath).fileName())
+                      .arg(bytesReused / 1024)
+                      .arg(bytesFetched / 1024);
+    updateStatusLabel();
+}
+
+void MainWindow::handleDeltaFailed(const QString &errorText)
+{
+    lastStatus_ = tr("Delta update unavailable (%1), downloading in full...").arg(errorText);
+    updateStatusLabel();
+    startFullDownloadAfterDelta();
+}
+
+void MainWindow::startFullDownloadAfterDelta()
+{
+    deltaPaused_ = false;
+    ui->pauseResumeButton->setEnabled(true);
+    ui->pauseResumeButton->setText(tr("Pause"));
+    attachTeeSinks();
+    downloader_.startNew(deltaUrl_, deltaPath_, deltaExpected_);
+    hasSavedState_ = true;
+}
+
+void MainWindow::startTransfer(const QUrl &url, const QString &filePath, const DownloadItem::Expected &expected)
+{
+    // Refresh an existing copy block by block when asked to, so a plain
+    // overwrite never costs a .zsync probe; tee targets need the full stream.
+    deltaPaused_ = false;
+    const QFileInfo existing{filePath};
+    if (deltaUpdates_ && teeTargets_.isEmpty() && existing.isFile() && existing.size() > 0)
+    {
+        deltaUrl_ = url;
+        deltaPath_ = filePath;
+        deltaExpected_ = expected;
+        ui->pauseResumeButton->setEnabled(true);
+        ui->pauseResumeButton->setText(tr("Pause"));
+        deltaSync_.start(url, filePath);
+        return;
+    }
+
+    attachTeeSinks();
+    downloader_.startNew(url, filePath, expected);
+    hasSavedState_ = true;
+}
+
+bool MainWindow::isBusy() const
+{
+    // The daemon queues transfers itself, so an attached window never blocks.
+    if (daemon_)
     {
         return false;
     }
+    return downloader_.isActive() || deltaSync_.isActive() || bulk_.isActive() || currentJob_.has_value();
+}
 
-    QFileInfo info{path};
-    if (!info.isAbsolute())
+void MainWindow::handleDaemonEnqueued(int item)
+{
+    daemonItem_ = item;
+    daemonState_ = QStringLiteral("queued");
+    lastStatus_ = tr("Queued on daemon as #%1").arg(item);
+    refreshPauseResumeState();
+    updateStatusLabel();
+}
+
+void MainWindow::handleDaemonState(int item, const QString &state, const QString &filePath, const QString &errorText)
+{
+    if (listModel_.contains(item))
+    {
+        listModel_.setState(item, state);
+    }
+    else
+    {
+        listModel_.addItem(item, QFileInfo(filePath).fileName(), QUrl{}, state);
+    }
+
+    if (item != daemonItem_)
+    {
+        return;
+    }
+
+    daemonState_ = state;
+    if (state == QLatin1String("finished"))
+    {
+        handleFinished(filePath);
+    }
+    else if (state == QLatin1String("failed"))
+    {
+        handleFailure(errorText);
+    }
+    else if (state == QLatin1String("paused") || state == QLatin1String("cancelled"))
+    {
+        lastSpeed_ = 0.0;
+        lastStatus_ = state == QLatin1String("paused") ? tr("Paused") : tr("Cancelled");
+        updateStatusLabel();
+    }
+    refreshPauseResumeState();
+}
+
+void MainWindow::handleDaemonProgress(int item, qint64 bytesReceived, qint64 bytesTotal, double kbps)
+{
+    listModel_.setProgress(item, bytesReceived, bytesTotal);
+    listModel_.setSpeed(item, kbps);
+    if (item != daemonItem_)
+    {
+        return;
+    }
+
+    lastSpeed_ = kbps;
+    updateProgress(bytesReceived, bytesTotal);
+}
+
+void MainWindow::handleDaemonStatus(int item, const QString &text)
+{
+    if (item == daemonItem_)
+    {
+        updateStatusText(text);
+    }
+}
+
+void MainWindow::handleDaemonLost()
+{
+    daemon_->disconnect(this);
+    daemon_ = nullptr;
+    daemonItem_ = -1;
+    daemonState_.clear();
+    ui->buttonDownload->setEnabled(true);
+    lastStatus_ = tr("Lost connection to the download daemon");
+    refreshPauseResumeState();
+    updateStatusLabel();
+}
+
+bool MainWindow::suitsBulkMode(const QList<QueuedDownload> &jobs) const
+{
+    // Many small files with known sizes are dominated by per-file setup, so
+    // they skip DownloadItem; tee targets need its streaming pipeline.
+    if (jobs.size() < kBulkMinFiles || !teeTargets_.isEmpty())
     {
         return false;
     }
 
-    const QString downloadDir{QStandardPaths::writableLocation(QStandardPaths::DownloadLocation)};
-    const QString homeDir{QDir::homePath()};
-    const QString cleanPath{QDir::cleanPath(info.absoluteFilePath())};
-    const QString cleanDownload{QDir::cleanPath(downloadDir.isEmpty() ? homeDir : downloadDir)};
-    const QString cleanHome{QDir::cleanPath(homeDir)};
+    for (const auto &job : jobs)
+    {
+        if (job.entry.size < 0 || job.entry.size > kBulkMaxFileBytes || job.entry.urls.isEmpty())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MainWindow::startBulk(const QList<QueuedDownload> &jobs)
+{
+    bulkJobs_ = jobs;
+    bulkListIds_.clear();
+    QList<BulkDownloader::Job> bulkJobs{};
+    for (const auto &job : jobs)
+    {
+        bulkListIds_.insert(job.filePath, job.listId);
+        bulkJobs.append(BulkDownloader::Job{job.entry.urls.at(job.mirrorIndex), job.filePath,
+                                            DownloadItem::Expected{job.entry.size, job.entry.hashType, job.entry.hash},
+                                            job.entry.urls.mid(job.mirrorIndex + 1)});
+    }
+
+    hasBulkCheckpoint_ = false;
+    resetProgress();
+    lastStatus_ = tr("Bulk download of %1 files...").arg(jobs.size());
+    ui->buttonDownload->setEnabled(false);
+    refreshPauseResumeState();
+    updateStatusLabel();
+
+    bulk_.start(bulkJobs);
+}
+
+void MainWindow::resumeBulkCheckpoint()
+{
+    batchCompleted_ = 0;
+    batchSkipped_ = 0;
+    batchFailed_ = 0;
+
+    QList<QueuedDownload> jobs{};
+    for (const auto &saved : BulkDownloader::loadCheckpoint())
+    {
+        if (!DownloadItem::isSafePath(saved.filePath))
+        {
+            ++batchFailed_;
+            continue;
+        }
+
+        ManifestEntry entry{};
+        entry.fileName = QFileInfo(saved.filePath).fileName();
+        entry.urls = QList<QUrl>{saved.url} + saved.mirrors;
+        entry.size = saved.expected.size;
+        entry.hashType = saved.expected.hashType;
+        entry.hash = saved.expected.hash;
+        // Rows from a pass paused in this session are reused, not duplicated.
+        int listId{bulkListIds_.value(saved.filePath)};
+        if (listModel_.contains(listId))
+        {
+            listModel_.setState(listId, QStringLiteral("queued"));
+        }
+        else
+        {
+            listId = addLocalListItem(saved.url, saved.filePath, QStringLiteral("queued"));
+        }
+        jobs.append(QueuedDownload{entry, saved.filePath, 0, listId});
+    }
+
+    startBulk(jobs);
+}
 
-    const bool underDownload{cleanPath.startsWith(cleanDownload + QLatin1Char('/')) || cleanPath == cleanDownload};
-    const bool underHome{cleanPath.startsWith(cleanHome + QLatin1Char('/')) || cleanPath == cleanHome};
+void MainWindow::handleBulkFileDone(int index, const QString &state)
+{
+    if (state == QLatin1String("finished"))
+    {
+        ++batchCompleted_;
+    }
+    else
+    {
+        ++batchSkipped_;
+    }
+    listModel_.setState(bulkJobs_.at(index).listId, state);
+}
 
-    return underDownload || underHome;
+void MainWindow::handleBulkFailed(int index, const QString &, const QString &)
+{
+    // Files with another mirror get a second chance through the regular
+    // queue once the bulk pass is over.
+    QueuedDownload job{bulkJobs_.at(index)};
+    if (job.mirrorIndex + 1 < job.entry.urls.size())
+    {
+        ++job.mirrorIndex;
+        queue_.append(job);
+        listModel_.setState(job.listId, QStringLiteral("queued"));
+        return;
+    }
+
+    ++batchFailed_;
+    listModel_.setState(job.listId, QStringLiteral("failed"));
+}
+
+void MainWindow::handleBulkProgress(int filesDone, int filesTotal, double filesPerSecond)
+{
+    lastReceived_ = filesDone;
+    lastTotal_ = filesTotal;
+    ui->progressBar->setRange(0, 100);
+    ui->progressBar->setValue(filesTotal > 0 ? (filesDone * 100) / filesTotal : 100);
+    lastStatus_ = tr("Bulk: %1/%2 files, %3 files/s").arg(filesDone).arg(filesTotal).arg(QString::number(filesPerSecond, 'f', 1));
+    updateStatusLabel();
+}
+
+void MainWindow::handleBulkFinished()
+{
+    const double rate{bulk_.filesPerSecond()};
+    bulkJobs_.clear();
+    hasBulkCheckpoint_ = !BulkDownloader::loadCheckpoint().isEmpty();
+
+    const bool hasRetries{!queue_.isEmpty()};
+    bulkRetriesPending_ = hasRetries;
+    startNextQueued();
+    if (!hasRetries)
+    {
+        lastStatus_ += tr(" (%1 files/s)").arg(QString::number(rate, 'f', 1));
+        updateStatusLabel();
+    }
+}
+
+int MainWindow::addLocalListItem(const QUrl &url, const QString &filePath, const QString &state)
+{
+    const int id{nextLocalId_--};
+    listModel_.addItem(id, QFileInfo(filePath).fileName(), url, state);
+    return id;
+}
+
+void MainWindow::setLocalListState(const QString &state)
+{
+    if (!daemon_ && localItem_ != 0)
+    {
+        listModel_.setState(localItem_, state);
+    }
+}
+
+void MainWindow::attachTeeSinks()
+{
+    downloader_.clearSinks();
+    for (const auto &target : std::as_const(teeTargets_))
+    {
+        downloader_.addSink(std::make_unique<PipeSink>(target));
+    }
 }
@@ -1,9 +1,21 @@
 #pragma once
+#include <QHash>
+#include <QList>
 #include <QMainWindow>
+#include <QSortFilterProxyModel>
 #include <QString>
+#include <QStringList>
+#include <QTimer>
 #include <QUrl>
 
+#include <optional>
+
+#include "bulkdownloader.h"
+#include "daemonclient.h"
+#include "deltasync.h"
 #include "downloaditem.h"
+#include "downloadlistmodel.h"
+#include "manifest.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui
@@ -20,32 +32,104 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow() override;
 
+    void setTeeTargets(const QStringList &targets);
+    void setDurabilityPolicy(DownloadItem::DurabilityPolicy policy);
+    void setDeltaUpdates(bool enabled);
+    void attachToDaemon(DaemonClient *client);
+
 private slots:
     void handleDownload();
+    void handleImport();
     void handlePauseResume();
     void updateProgress(qint64 bytesReceived, qint64 bytesTotal);
     void updateSpeed(double kbps);
+    void updateBuffered(qint64 bytes);
     void updateStatusText(const QString &text);
     void handleFinished(const QString &filePath);
     void handleFailure(const QString &errorText);
     void handlePaused();
+    void advanceQueue();
+    void handlePreconnect();
+    void handleDeltaFinished(const QString &filePath, qint64 bytesReused, qint64 bytesFetched);
+    void handleDeltaFailed(const QString &errorText);
+    void handleDaemonEnqueued(int item);
+    void handleDaemonState(int item, const QString &state, const QString &filePath, const QString &errorText);
+    void handleDaemonProgress(int item, qint64 bytesReceived, qint64 bytesTotal, double kbps);
+    void handleDaemonStatus(int item, const QString &text);
+    void handleDaemonLost();
+    void handleBulkFileDone(int index, const QString &state);
+    void handleBulkFailed(int index, const QString &filePath, const QString &errorText);
+    void handleBulkProgress(int filesDone, int filesTotal, double filesPerSecond);
+    void handleBulkFinished();
 
 private:
+    struct QueuedDownload
+    {
+        ManifestEntry entry{};
+        QString filePath{};
+        int mirrorIndex{0};
+        int listId{0};
+    };
+
     void setupUiDefaults();
     void connectSignals();
     void refreshPauseResumeState();
     void updateStatusLabel();
     QString chooseSavePath(const QUrl &url);
-    bool isSafePath(const QString &path) const;
     void loadSavedState();
     void resetProgress();
+    QString manifestTargetPath(const QString &dir, const QString &fileName) const;
+    void startNextQueued();
+    void beginJob(const QueuedDownload &job, bool resumeSaved = false);
+    bool isAlreadyComplete(const QString &filePath, const ManifestEntry &entry) const;
+    void scheduleAdvance();
+    void attachTeeSinks();
+    void startTransfer(const QUrl &url, const QString &filePath, const DownloadItem::Expected &expected = {});
+    void startFullDownloadAfterDelta();
+    bool isBusy() const;
+    void setupDownloadList();
+    int addLocalListItem(const QUrl &url, const QString &filePath, const QString &state);
+    void setLocalListState(const QString &state);
+    bool suitsBulkMode(const QList<QueuedDownload> &jobs) const;
+    void startBulk(const QList<QueuedDownload> &jobs);
+    void resumeBulkCheckpoint();
 
     Ui::MainWindow *ui{};
     DownloadItem downloader_;
+    DeltaSync deltaSync_;
+    QUrl deltaUrl_{};
+    QString deltaPath_{};
+    DownloadItem::Expected deltaExpected_{};
+    bool deltaPaused_{false};
+    bool deltaUpdates_{false};
+    DaemonClient *daemon_{nullptr};
+    int daemonItem_{-1};
+    QString daemonState_{};
+
+    DownloadListModel listModel_{};
+    QSortFilterProxyModel listProxy_{};
+    int localItem_{0};
+    int nextLocalId_{-1};
+
+    BulkDownloader bulk_{};
+    QList<QueuedDownload> bulkJobs_{};
+    QHash<QString, int> bulkListIds_{};
+    bool hasBulkCheckpoint_{false};
+    bool bulkRetriesPending_{false};
     QUrl currentUrl_{};
     qint64 lastReceived_{0};
     qint64 lastTotal_{-1};
     double lastSpeed_{0.0};
+    qint64 lastBuffered_{0};
     QString lastStatus_{QStringLiteral("Idle")};
     bool hasSavedState_{false};
+    QTimer preconnectTimer_{};
+    QStringList teeTargets_{};
+
+    QList<QueuedDownload> queue_{};
+    std::optional<QueuedDownload> currentJob_{};
+    bool advancePending_{false};
+    int batchCompleted_{0};
+    int batchSkipped_{0};
+    int batchFailed_{0};
 };
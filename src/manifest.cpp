@@ -0,0 +1,292 @@
+#include "manifest.h"
+
+#include "checksum.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include <QXmlStreamReader>
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+    void setError(QString *errorText, const QString &text)
+    {
+        if (errorText)
+        {
+            *errorText = text;
+        }
+    }
+
+    QString fileNameFromUrl(const QUrl &url)
+    {
+        return QFileInfo{url.path()}.fileName();
+    }
+
+    void offerHash(ManifestEntry &entry, const QString &type, const QByteArray &value)
+    {
+        if (value.isEmpty() || !Checksum::algorithmFor(type))
+        {
+            return;
+        }
+
+        if (entry.hash.isEmpty() || Checksum::strength(type) > Checksum::strength(entry.hashType))
+        {
+            entry.hashType = type.toLower();
+            entry.hash = value.trimmed().toLower();
+        }
+    }
+
+    void finalizeEntry(ManifestEntry &entry)
+    {
+        if (entry.fileName.isEmpty() && !entry.urls.isEmpty())
+        {
+            entry.fileName = fileNameFromUrl(entry.urls.first());
+        }
+    }
+}
+
+bool ManifestEntry::isValid() const
+{
+    return !fileName.isEmpty() && !urls.isEmpty();
+}
+
+QList<ManifestEntry> Manifest::load(const QString &path, QString *errorText)
+{
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        setError(errorText, QStringLiteral("Cannot open manifest."));
+        return {};
+    }
+
+    const QByteArray data{file.readAll()};
+    const QString suffix{QFileInfo{path}.suffix().toLower()};
+    if (suffix == QLatin1String("meta4") || suffix == QLatin1String("metalink") || suffix == QLatin1String("xml"))
+    {
+        return parseMetalink(data, errorText);
+    }
+    if (suffix == QLatin1String("json"))
+    {
+        return parseJson(data, errorText);
+    }
+    if (suffix == QLatin1String("csv") || suffix == QLatin1String("txt"))
+    {
+        return parseCsv(data, errorText);
+    }
+
+    const QByteArray head{data.trimmed().left(1)};
+    if (head == "<")
+    {
+        return parseMetalink(data, errorText);
+    }
+    if (head == "{" || head == "[")
+    {
+        return parseJson(data, errorText);
+    }
+    return parseCsv(data, errorText);
+}
+
+QList<ManifestEntry> Manifest::parseMetalink(const QByteArray &data, QString *errorText)
+{
+    QList<ManifestEntry> entries{};
+    QXmlStreamReader xml{data};
+
+    ManifestEntry current{};
+    QList<std::pair<int, QUrl>> prioritizedUrls{};
+    bool inFile{false};
+    int piecesDepth{0};
+
+    while (!xml.atEnd())
+    {
+        xml.readNext();
+
+        if (xml.isStartElement())
+        {
+            const auto name{xml.name()};
+            if (name == QLatin1String("file"))
+            {
+                current = ManifestEntry{};
+                current.fileName = xml.attributes().value(QStringLiteral("name")).toString();
+                prioritizedUrls.clear();
+                inFile = true;
+            }
+            else if (!inFile)
+            {
+                continue;
+            }
+            else if (name == QLatin1String("pieces"))
+            {
+                ++piecesDepth;
+            }
+            else if (piecesDepth > 0)
+            {
+                continue;
+            }
+            else if (name == QLatin1String("size"))
+            {
+                bool ok{false};
+                const qint64 size{xml.readElementText().trimmed().toLongLong(&ok)};
+                current.size = ok ? size : -1;
+            }
+            else if (name == QLatin1String("hash"))
+            {
+                const QString type{xml.attributes().value(QStringLiteral("type")).toString()};
+                offerHash(current, type, xml.readElementText().toLatin1());
+            }
+            else if (name == QLatin1String("url"))
+            {
+                bool ok{false};
+                int priority{xml.attributes().value(QStringLiteral("priority")).toInt(&ok)};
+                if (!ok)
+                {
+                    priority = 999999;
+                }
+                const QUrl url{xml.readElementText().trimmed()};
+                if (url.isValid() && !url.isRelative())
+                {
+                    prioritizedUrls.append({priority, url});
+                }
+            }
+        }
+        else if (xml.isEndElement())
+        {
+            const auto name{xml.name()};
+            if (name == QLatin1String("pieces") && piecesDepth > 0)
+            {
+                --piecesDepth;
+            }
+            else if (name == QLatin1String("file") && inFile)
+            {
+                std::stable_sort(prioritizedUrls.begin(), prioritizedUrls.end(),
+                                 [](const auto &lhs, const auto &rhs)
+                                 { return lhs.first < rhs.first; });
+                for (const auto &[priority, url] : std::as_const(prioritizedUrls))
+                {
+                    current.urls.append(url);
+                }
+                finalizeEntry(current);
+                if (current.isValid())
+                {
+                    entries.append(current);
+                }
+                inFile = false;
+            }
+        }
+    }
+
+    if (xml.hasError())
+    {
+        setError(errorText, QStringLiteral("Invalid Metalink: ") + xml.errorString());
+        return {};
+    }
+
+    return entries;
+}
+
+QList<ManifestEntry> Manifest::parseJson(const QByteArray &data, QString *errorText)
+{
+    QJsonParseError parseError{};
+    const auto doc{QJsonDocument::fromJson(data, &parseError)};
+    if (parseError.error != QJsonParseError::NoError)
+    {
+        setError(errorText, QStringLiteral("Invalid JSON manifest: ") + parseError.errorString());
+        return {};
+    }
+
+    const QJsonArray files{doc.isArray() ? doc.array() : doc.object().value(QStringLiteral("files")).toArray()};
+
+    QList<ManifestEntry> entries{};
+    entries.reserve(files.size());
+    for (const auto &value : files)
+    {
+        const QJsonObject obj{value.toObject()};
+        ManifestEntry entry{};
+        entry.fileName = obj.value(QStringLiteral("name")).toString();
+
+        QJsonArray mirrors{obj.value(QStringLiteral("urls")).toArray()};
+        const QJsonValue single{obj.value(QStringLiteral("url"))};
+        if (single.isString())
+        {
+            mirrors.prepend(single);
+        }
+        for (const auto &mirror : std::as_const(mirrors))
+        {
+            const QUrl url{mirror.toString()};
+            if (url.isValid() && !url.isRelative())
+            {
+                entry.urls.append(url);
+            }
+        }
+
+        const QJsonValue size{obj.value(QStringLiteral("size"))};
+        entry.size = size.isDouble() ? static_cast<qint64>(size.toDouble()) : -1;
+
+        offerHash(entry, obj.value(QStringLiteral("hashType")).toString(), obj.value(QStringLiteral("hash")).toString().toLatin1());
+
+        finalizeEntry(entry);
+        if (entry.isValid())
+        {
+            entries.append(entry);
+        }
+    }
+
+    if (entries.isEmpty())
+    {
+        setError(errorText, QStringLiteral("Manifest lists no downloadable files."));
+    }
+    return entries;
+}
+
+QList<ManifestEntry> Manifest::parseCsv(const QByteArray &data, QString *errorText)
+{
+    QList<ManifestEntry> entries{};
+
+    const QList<QByteArray> lines{data.split('\n')};
+    for (const auto &rawLine : lines)
+    {
+        const QString line{QString::fromUtf8(rawLine).trimmed()};
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#')) || line.startsWith(QLatin1String("url,"), Qt::CaseInsensitive))
+        {
+            continue;
+        }
+
+        const QStringList fields{line.split(QLatin1Char(','))};
+        ManifestEntry entry{};
+
+        const QStringList mirrors{fields.value(0).split(QLatin1Char(' '), Qt::SkipEmptyParts)};
+        for (const auto &mirror : mirrors)
+        {
+            const QUrl url{mirror.trimmed()};
+            if (url.isValid() && !url.isRelative())
+            {
+                entry.urls.append(url);
+            }
+        }
+
+        entry.fileName = fields.value(1).trimmed();
+
+        bool ok{false};
+        const qint64 size{fields.value(2).trimmed().toLongLong(&ok)};
+        entry.size = ok ? size : -1;
+
+        offerHash(entry, fields.value(3).trimmed(), fields.value(4).trimmed().toLatin1());
+
+        finalizeEntry(entry);
+        if (entry.isValid())
+        {
+            entries.append(entry);
+        }
+    }
+
+    if (entries.isEmpty())
+    {
+        setError(errorText, QStringLiteral("Manifest lists no downloadable files."));
+    }
+    return entries;
+}
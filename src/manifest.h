@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QUrl>
+
+struct ManifestEntry
+{
+    QString fileName{};
+    QList<QUrl> urls{};
+    qint64 size{-1};
+    QString hashType{};
+    QByteArray hash{};
+
+    bool isValid() const;
+};
+
+class Manifest
+{
+public:
+    static QList<ManifestEntry> load(const QString &path, QString *errorText = nullptr);
+
+    static QList<ManifestEntry> parseMetalink(const QByteArray &data, QString *errorText = nullptr);
+    static QList<ManifestEntry> parseJson(const QByteArray &data, QString *errorText = nullptr);
+    static QList<ManifestEntry> parseCsv(const QByteArray &data, QString *errorText = nullptr);
+};
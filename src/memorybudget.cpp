@@ -0,0 +1,84 @@
+#include "memorybudget.h"
+
+#include <QMutexLocker>
+
+namespace
+{
+    constexpr qint64 kMinimumGrantBytes{128 * 1024};
+}
+
+MemoryBudget &MemoryBudget::instance()
+{
+    static MemoryBudget budget{};
+    return budget;
+}
+
+void MemoryBudget::setGlobalLimit(qint64 bytes)
+{
+    QMutexLocker locker{&mutex_};
+    globalLimit_ = qMax(kMinimumGrantBytes, bytes);
+}
+
+qint64 MemoryBudget::globalLimit() const
+{
+    QMutexLocker locker{&mutex_};
+    return globalLimit_;
+}
+
+qint64 MemoryBudget::reserve(const void *owner, qint64 wanted)
+{
+    QMutexLocker locker{&mutex_};
+
+    qint64 others{0};
+    for (auto it{usage_.constBegin()}; it != usage_.constEnd(); ++it)
+    {
+        if (it.key() != owner)
+        {
+            others += it->reserved;
+        }
+    }
+
+    // Every download gets a small floor so none of them can starve, which
+    // means the global cap can be exceeded by at most that floor per item.
+    const qint64 granted{qBound(kMinimumGrantBytes, globalLimit_ - others, qMax(kMinimumGrantBytes, wanted))};
+    usage_[owner].reserved = granted;
+    return granted;
+}
+
+void MemoryBudget::release(const void *owner)
+{
+    QMutexLocker locker{&mutex_};
+    usage_.remove(owner);
+}
+
+void MemoryBudget::report(const void *owner, qint64 bufferedBytes)
+{
+    QMutexLocker locker{&mutex_};
+    const auto it{usage_.find(owner)};
+    if (it != usage_.end())
+    {
+        it->buffered = bufferedBytes;
+    }
+}
+
+qint64 MemoryBudget::reserved() const
+{
+    QMutexLocker locker{&mutex_};
+    qint64 total{0};
+    for (const auto &usage : usage_)
+    {
+        total += usage.reserved;
+    }
+    return total;
+}
+
+qint64 MemoryBudget::buffered() const
+{
+    QMutexLocker locker{&mutex_};
+    qint64 total{0};
+    for (const auto &usage : usage_)
+    {
+        total += usage.buffered;
+    }
+    return total;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+
+class MemoryBudget
+{
+public:
+    static MemoryBudget &instance();
+
+    void setGlobalLimit(qint64 bytes);
+    qint64 globalLimit() const;
+
+    qint64 reserve(const void *owner, qint64 wanted);
+    void release(const void *owner);
+    void report(const void *owner, qint64 bufferedBytes);
+
+    qint64 reserved() const;
+    qint64 buffered() const;
+
+private:
+    MemoryBudget() = default;
+
+    struct Usage
+    {
+        qint64 reserved{0};
+        qint64 buffered{0};
+    };
+
+    mutable QMutex mutex_{};
+    QHash<const void *, Usage> usage_{};
+    qint64 globalLimit_{256LL * 1024LL * 1024LL};
+};
@@ -0,0 +1,259 @@
+#include "pipesink.h"
+
+#include <QFile>
+#include <QSocketNotifier>
+
+#ifndef Q_OS_WIN
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    bool isStdout(const QString &target)
+    {
+        return target == QLatin1String("-");
+    }
+}
+
+PipeSink::PipeSink(const QString &target)
+    : target_(target)
+{
+}
+
+PipeSink::~PipeSink()
+{
+    closeDevice();
+}
+
+QString PipeSink::name() const
+{
+    return isStdout(target_) ? QStringLiteral("stdout") : target_;
+}
+
+bool PipeSink::open(qint64 offset)
+{
+    if (offset != position_)
+    {
+        return fail(QStringLiteral("Cannot resume a stream at a different offset"));
+    }
+
+    return openDevice();
+}
+
+bool PipeSink::write(const QByteArray &data)
+{
+    if (broken_)
+    {
+        return failBroken();
+    }
+
+    queue_.append(data);
+    position_ += data.size();
+    return drain();
+}
+
+bool PipeSink::flush()
+{
+    if (broken_)
+    {
+        return failBroken();
+    }
+    return drain();
+}
+
+bool PipeSink::close()
+{
+    bool drained{true};
+#ifndef Q_OS_WIN
+    if (fd_ >= 0 && !broken_ && !queue_.isEmpty())
+    {
+        ::fcntl(fd_, F_SETFL, originalFlags_ & ~O_NONBLOCK);
+        drained = drain();
+    }
+#endif
+    closeDevice();
+    return drained;
+}
+
+bool PipeSink::failBroken()
+{
+    // Keep the original write error if there is one, so retries report it too.
+    return fail(errorString().isEmpty() ? QStringLiteral("Stream is broken") : errorString());
+}
+
+qint64 PipeSink::pendingBytes() const
+{
+    return queue_.size();
+}
+
+#ifdef Q_OS_WIN
+
+bool PipeSink::openDevice()
+{
+    if (device_)
+    {
+        return true;
+    }
+
+    device_ = std::make_unique<QFile>();
+    bool opened{false};
+    if (isStdout(target_))
+    {
+        opened = device_->open(stdout, QIODevice::WriteOnly | QIODevice::Unbuffered);
+    }
+    else
+    {
+        device_->setFileName(target_);
+        opened = device_->open(QIODevice::WriteOnly | QIODevice::Unbuffered);
+    }
+
+    if (!opened)
+    {
+        const QString reason{device_->errorString()};
+        device_.reset();
+        return fail(reason);
+    }
+    return true;
+}
+
+bool PipeSink::drain()
+{
+    if (!device_)
+    {
+        return true;
+    }
+
+    if (device_->write(queue_) != queue_.size())
+    {
+        broken_ = true;
+        return fail(device_->errorString());
+    }
+    queue_.resize(0);
+    return true;
+}
+
+void PipeSink::closeDevice()
+{
+    device_.reset();
+}
+
+#else
+
+bool PipeSink::openDevice()
+{
+    if (fd_ >= 0)
+    {
+        return true;
+    }
+
+    if (isStdout(target_))
+    {
+        fd_ = STDOUT_FILENO;
+        ownsFd_ = false;
+    }
+    else
+    {
+        // Never create or truncate: a mistyped target must not clobber a file.
+        fd_ = ::open(QFile::encodeName(target_).constData(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+        ownsFd_ = true;
+    }
+
+    if (fd_ < 0)
+    {
+        const QString reason{QString::fromLocal8Bit(std::strerror(errno))};
+        fd_ = -1;
+        return fail(errno == ENXIO ? QStringLiteral("Named pipe has no reader") : reason);
+    }
+
+    struct stat info{};
+    const bool isPipe{::fstat(fd_, &info) == 0 && S_ISFIFO(info.st_mode)};
+    if (!isPipe && ownsFd_)
+    {
+        closeDevice();
+        return fail(QStringLiteral("Not a named pipe: ") + target_);
+    }
+
+    originalFlags_ = ::fcntl(fd_, F_GETFL);
+    if (isPipe)
+    {
+        ::fcntl(fd_, F_SETFL, originalFlags_ | O_NONBLOCK);
+        notifier_ = std::make_unique<QSocketNotifier>(fd_, QSocketNotifier::Write);
+        notifier_->setEnabled(false);
+        QObject::connect(notifier_.get(), &QSocketNotifier::activated, notifier_.get(), [this]()
+                         { drain(); });
+    }
+    else
+    {
+        ::fcntl(fd_, F_SETFL, originalFlags_ & ~O_NONBLOCK);
+    }
+    return true;
+}
+
+bool PipeSink::drain()
+{
+    if (fd_ < 0)
+    {
+        return true;
+    }
+
+    while (!queue_.isEmpty())
+    {
+        const ssize_t written{::write(fd_, queue_.constData(), static_cast<size_t>(queue_.size()))};
+        if (written > 0)
+        {
+            queue_.remove(0, written);
+            continue;
+        }
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            if (notifier_)
+            {
+                notifier_->setEnabled(true);
+            }
+            return true;
+        }
+
+        broken_ = true;
+        if (notifier_)
+        {
+            notifier_->setEnabled(false);
+        }
+        return fail(QString::fromLocal8Bit(std::strerror(errno)));
+    }
+
+    if (notifier_)
+    {
+        notifier_->setEnabled(false);
+    }
+    return true;
+}
+
+void PipeSink::closeDevice()
+{
+    notifier_.reset();
+    if (fd_ < 0)
+    {
+        return;
+    }
+
+    if (originalFlags_ >= 0)
+    {
+        ::fcntl(fd_, F_SETFL, originalFlags_);
+    }
+    if (ownsFd_)
+    {
+        ::close(fd_);
+    }
+    fd_ = -1;
+    originalFlags_ = -1;
+}
+
+#endif
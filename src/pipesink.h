@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+#include <memory>
+
+#include "datasink.h"
+
+class QFile;
+class QSocketNotifier;
+
+class PipeSink : public DataSink
+{
+public:
+    explicit PipeSink(const QString &target);
+    ~PipeSink() override;
+
+    QString name() const override;
+    bool open(qint64 offset) override;
+    bool write(const QByteArray &data) override;
+    bool flush() override;
+    bool close() override;
+    qint64 pendingBytes() const override;
+
+private:
+    bool openDevice();
+    bool drain();
+    bool failBroken();
+    void closeDevice();
+
+    QString target_{};
+    QByteArray queue_{};
+    qint64 position_{0};
+    bool broken_{false};
+#ifdef Q_OS_WIN
+    std::unique_ptr<QFile> device_{};
+#else
+    int fd_{-1};
+    int originalFlags_{-1};
+    bool ownsFd_{false};
+    std::unique_ptr<QSocketNotifier> notifier_{};
+#endif
+};
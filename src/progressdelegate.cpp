@@ -0,0 +1,24 @@
+#include "progressdelegate.h"
+
+#include <QApplication>
+#include <QStyle>
+#include <QStyleOption>
+
+void ProgressDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    const int percent{index.data().toInt()};
+
+    QStyleOptionProgressBar bar{};
+    bar.rect = option.rect.adjusted(2, 2, -2, -2);
+    bar.state = option.state | QStyle::State_Horizontal;
+    bar.minimum = 0;
+    bar.maximum = 100;
+    bar.progress = qMax(0, percent);
+    bar.text = percent >= 0 ? QStringLiteral("%1%").arg(percent) : QString{};
+    bar.textVisible = percent >= 0;
+
+    const QWidget *widget{option.widget};
+    QStyle *style{widget ? widget->style() : QApplication::style()};
+    style->drawPrimitive(QStyle::PE_PanelItemViewItem, &option, painter, widget);
+    style->drawControl(QStyle::CE_ProgressBar, &bar, painter, widget);
+}
@@ -0,0 +1,254 @@
+#include "redirectcache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QSet>
+#include <QStandardPaths>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QNetworkRequest>
+
+#include <optional>
+
+namespace
+{
+    constexpr int kMaxEntries{512};
+
+    struct Freshness
+    {
+        bool storable{true};
+        std::optional<qint64> maxAgeSecs{};
+    };
+
+    Freshness parseFreshness(const QNetworkReply &reply)
+    {
+        Freshness freshness{};
+
+        const QList<QByteArray> directives{reply.rawHeader(QByteArrayLiteral("Cache-Control")).toLower().split(',')};
+        for (const auto &rawDirective : directives)
+        {
+            const QByteArray directive{rawDirective.trimmed()};
+            if (directive == "no-store" || directive == "no-cache")
+            {
+                freshness.storable = false;
+            }
+            else if (directive.startsWith("max-age=") || directive.startsWith("s-maxage="))
+            {
+                bool ok{false};
+                const qint64 secs{directive.mid(directive.indexOf('=') + 1).toLongLong(&ok)};
+                if (ok)
+                {
+                    freshness.maxAgeSecs = secs;
+                }
+            }
+        }
+
+        const QByteArray expires{reply.rawHeader(QByteArrayLiteral("Expires"))};
+        if (!freshness.maxAgeSecs && !expires.isEmpty())
+        {
+            const QDateTime when{QDateTime::fromString(QString::fromLatin1(expires), Qt::RFC2822Date)};
+            freshness.maxAgeSecs = when.isValid() ? QDateTime::currentDateTimeUtc().secsTo(when) : 0;
+        }
+
+        if (freshness.maxAgeSecs && *freshness.maxAgeSecs <= 0)
+        {
+            freshness.storable = false;
+        }
+
+        return freshness;
+    }
+}
+
+RedirectCache &RedirectCache::instance()
+{
+    static RedirectCache cache{};
+    return cache;
+}
+
+RedirectCache::RedirectCache()
+{
+    load();
+}
+
+bool RedirectCache::Entry::isFresh(const QDateTime &now) const
+{
+    return target.isValid() && (permanent || expires > now);
+}
+
+void RedirectCache::record(const QUrl &from, const QUrl &to, const QNetworkReply &reply)
+{
+    const int status{reply.attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt()};
+    const Freshness freshness{parseFreshness(reply)};
+    const QString key{keyFor(from)};
+
+    const auto existing{entries_.constFind(key)};
+    const bool wasPermanent{existing != entries_.constEnd() && existing->permanent};
+
+    // Temporary redirects are only reusable with explicit freshness.
+    const bool permanentStatus{status == 301 || status == 308};
+    const bool temporaryStatus{status == 302 || status == 303 || status == 307};
+    const bool cacheable{permanentStatus || (temporaryStatus && freshness.maxAgeSecs)};
+    if (!freshness.storable || !cacheable || !to.isValid() || keyFor(to) == key)
+    {
+        entries_.remove(key);
+        if (wasPermanent)
+        {
+            save();
+        }
+        return;
+    }
+
+    Entry entry{};
+    entry.target = to;
+    entry.lastUsed = ++useClock_;
+    if (freshness.maxAgeSecs)
+    {
+        entry.expires = QDateTime::currentDateTimeUtc().addSecs(*freshness.maxAgeSecs);
+    }
+    else
+    {
+        entry.permanent = true;
+    }
+
+    const bool changed{wasPermanent != entry.permanent || (entry.permanent && existing->target != to)};
+    entries_.insert(key, entry);
+    const bool evictedPermanent{entries_.size() > kMaxEntries && evictLeastRecent()};
+    if (changed || evictedPermanent)
+    {
+        save();
+    }
+}
+
+bool RedirectCache::evictLeastRecent()
+{
+    auto oldest{entries_.begin()};
+    for (auto it{entries_.begin()}; it != entries_.end(); ++it)
+    {
+        if (it->lastUsed < oldest->lastUsed)
+        {
+            oldest = it;
+        }
+    }
+
+    const bool permanent{oldest->permanent};
+    entries_.erase(oldest);
+    return permanent;
+}
+
+QUrl RedirectCache::resolve(const QUrl &url, int maxHops, int *hops)
+{
+    const QDateTime now{QDateTime::currentDateTimeUtc()};
+    QSet<QString> seen{};
+    QUrl current{url};
+    int count{0};
+
+    while (count < maxHops)
+    {
+        const QString key{keyFor(current)};
+        const auto it{entries_.constFind(key)};
+        if (it == entries_.constEnd() || seen.contains(key))
+        {
+            break;
+        }
+        if (!it->isFresh(now))
+        {
+            entries_.erase(it);
+            break;
+        }
+
+        seen.insert(key);
+        entries_[key].lastUsed = ++useClock_;
+        current = it->target;
+        ++count;
+    }
+
+    if (hops)
+    {
+        *hops = count;
+    }
+    return current;
+}
+
+void RedirectCache::invalidate(const QUrl &url)
+{
+    QSet<QString> seen{};
+    QString key{keyFor(url)};
+    bool hadPermanent{false};
+
+    while (!seen.contains(key))
+    {
+        const auto it{entries_.constFind(key)};
+        if (it == entries_.constEnd())
+        {
+            break;
+        }
+
+        seen.insert(key);
+        hadPermanent = hadPermanent || it->permanent;
+        const QString next{keyFor(it->target)};
+        entries_.erase(it);
+        key = next;
+    }
+
+    if (hadPermanent)
+    {
+        save();
+    }
+}
+
+QString RedirectCache::keyFor(const QUrl &url)
+{
+    return url.adjusted(QUrl::RemoveFragment | QUrl::NormalizePathSegments).toString(QUrl::FullyEncoded);
+}
+
+void RedirectCache::load()
+{
+    QFile file{storagePath()};
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return;
+    }
+
+    const auto doc{QJsonDocument::fromJson(file.readAll())};
+    const QJsonObject obj{doc.object()};
+    for (auto it{obj.constBegin()}; it != obj.constEnd(); ++it)
+    {
+        Entry entry{};
+        entry.target = QUrl{it.value().toString()};
+        entry.permanent = true;
+        entry.lastUsed = ++useClock_;
+        if (entry.target.isValid() && entries_.size() < kMaxEntries)
+        {
+            entries_.insert(it.key(), entry);
+        }
+    }
+}
+
+void RedirectCache::save() const
+{
+    QJsonObject obj{};
+    for (auto it{entries_.constBegin()}; it != entries_.constEnd(); ++it)
+    {
+        if (it->permanent)
+        {
+            obj.insert(it.key(), it->target.toString(QUrl::FullyEncoded));
+        }
+    }
+
+    QFile file{storagePath()};
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return;
+    }
+
+    file.write(QJsonDocument{obj}.toJson(QJsonDocument::Compact));
+}
+
+QString RedirectCache::storagePath() const
+{
+    const QString dir{QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)};
+    QDir{}.mkpath(dir);
+    return dir + QStringLiteral("/redirects.json");
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QDateTime>
+#include <QHash>
+#include <QString>
+#include <QUrl>
+
+class QNetworkReply;
+
+class RedirectCache
+{
+public:
+    static RedirectCache &instance();
+
+    void record(const QUrl &from, const QUrl &to, const QNetworkReply &reply);
+    QUrl resolve(const QUrl &url, int maxHops, int *hops = nullptr);
+    void invalidate(const QUrl &url);
+
+private:
+    RedirectCache();
+
+    struct Entry
+    {
+        QUrl target{};
+        QDateTime expires{};
+        bool permanent{false};
+        quint64 lastUsed{0};
+
+        bool isFresh(const QDateTime &now) const;
+    };
+
+    static QString keyFor(const QUrl &url);
+    bool evictLeastRecent();
+    void load();
+    void save() const;
+    QString storagePath() const;
+
+    QHash<QString, Entry> entries_{};
+    quint64 useClock_{0};
+};
@@ -0,0 +1,142 @@
+#include "tracer.h"
+
+#include <QJsonDocument>
+
+#include <utility>
+
+namespace
+{
+    constexpr std::size_t kFlushBatch{256};
+    constexpr qint64 kMaxEvents{2000000};
+}
+
+Tracer &Tracer::instance()
+{
+    static Tracer tracer{};
+    return tracer;
+}
+
+Tracer::Tracer()
+{
+    clock_.start();
+}
+
+void Tracer::enable(const QString &outputPath)
+{
+    // Events are streamed in the JSON array trace format, which viewers
+    // accept without a closing bracket, so nothing piles up in memory and
+    // a crashed run still leaves a readable trace.
+    file_.setFileName(outputPath);
+    enabled_ = !outputPath.isEmpty() && file_.open(QIODevice::WriteOnly | QIODevice::Truncate) && file_.write("[\n") == 2;
+}
+
+bool Tracer::isEnabled() const
+{
+    return enabled_;
+}
+
+qint64 Tracer::nowUs() const
+{
+    return clock_.nsecsElapsed() / 1000;
+}
+
+int Tracer::newTrack()
+{
+    return nextTrack_++;
+}
+
+void Tracer::nameTrack(int track, const QString &name)
+{
+    if (!enabled_)
+    {
+        return;
+    }
+
+    QJsonObject args{};
+    args.insert(QStringLiteral("name"), name);
+    record(Event{QStringLiteral("thread_name"), {}, 'M', track, 0, 0, args});
+}
+
+void Tracer::complete(const QString &name, const QString &category, int track, qint64 startUs, qint64 endUs, const QJsonObject &args)
+{
+    if (!enabled_)
+    {
+        return;
+    }
+
+    record(Event{name, category, 'X', track, startUs, qMax<qint64>(0, endUs - startUs), args});
+}
+
+void Tracer::instant(const QString &name, const QString &category, int track, const QJsonObject &args)
+{
+    if (!enabled_)
+    {
+        return;
+    }
+
+    record(Event{name, category, 'i', track, nowUs(), 0, args});
+}
+
+bool Tracer::flush()
+{
+    if (!enabled_ || pending_.empty())
+    {
+        return true;
+    }
+
+    QByteArray chunk{};
+    for (const auto &event : pending_)
+    {
+        chunk += serialize(event);
+    }
+    pending_.clear();
+
+    return file_.write(chunk) == chunk.size() && file_.flush();
+}
+
+void Tracer::record(Event event)
+{
+    if (recorded_ >= kMaxEvents)
+    {
+        return;
+    }
+
+    if (++recorded_ == kMaxEvents)
+    {
+        event = Event{QStringLiteral("trace truncated"), QStringLiteral("tracer"), 'i', 0, nowUs(), 0, {}};
+    }
+
+    pending_.push_back(std::move(event));
+    if (pending_.size() >= kFlushBatch)
+    {
+        flush();
+    }
+}
+
+QByteArray Tracer::serialize(const Event &event)
+{
+    QJsonObject obj{};
+    obj.insert(QStringLiteral("name"), event.name);
+    obj.insert(QStringLiteral("ph"), QString{QLatin1Char(event.phase)});
+    obj.insert(QStringLiteral("pid"), 1);
+    obj.insert(QStringLiteral("tid"), event.track);
+    if (event.phase != 'M')
+    {
+        obj.insert(QStringLiteral("cat"), event.category);
+        obj.insert(QStringLiteral("ts"), static_cast<double>(event.startUs));
+    }
+    if (event.phase == 'X')
+    {
+        obj.insert(QStringLiteral("dur"), static_cast<double>(event.durationUs));
+    }
+    if (event.phase == 'i')
+    {
+        obj.insert(QStringLiteral("s"), QStringLiteral("t"));
+    }
+    if (!event.args.isEmpty())
+    {
+        obj.insert(QStringLiteral("args"), event.args);
+    }
+
+    return QJsonDocument{obj}.toJson(QJsonDocument::Compact) + ",\n";
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonObject>
+#include <QString>
+
+#include <vector>
+
+class Tracer
+{
+public:
+    static Tracer &instance();
+
+    void enable(const QString &outputPath);
+    bool isEnabled() const;
+
+    qint64 nowUs() const;
+    int newTrack();
+    void nameTrack(int track, const QString &name);
+
+    void complete(const QString &name, const QString &category, int track, qint64 startUs, qint64 endUs, const QJsonObject &args = {});
+    void instant(const QString &name, const QString &category, int track, const QJsonObject &args = {});
+
+    bool flush();
+
+private:
+    Tracer();
+
+    struct Event
+    {
+        QString name{};
+        QString category{};
+        char phase{'X'};
+        int track{0};
+        qint64 startUs{0};
+        qint64 durationUs{0};
+        QJsonObject args{};
+    };
+
+    void record(Event event);
+    static QByteArray serialize(const Event &event);
+
+    QElapsedTimer clock_{};
+    QFile file_{};
+    std::vector<Event> pending_{};
+    qint64 recorded_{0};
+    int nextTrack_{1};
+    bool enabled_{false};
+};
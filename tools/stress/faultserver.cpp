@@ -0,0 +1,192 @@
+#include "faultserver.h"
+
+#include <QHostAddress>
+#include <QList>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include <memory>
+
+namespace
+{
+    constexpr qint64 kDripChunkBytes{16 * 1024};
+    constexpr int kDripIntervalMs{10};
+    constexpr qint64 kTruncatedTailBytes{1024};
+
+    qint64 parseRangeStart(const QByteArray &head)
+    {
+        const QList<QByteArray> lines{head.split('\n')};
+        for (const auto &rawLine : lines)
+        {
+            const QByteArray line{rawLine.trimmed()};
+            if (!line.toLower().startsWith("range:"))
+            {
+                continue;
+            }
+
+            const QByteArray value{line.mid(6).trimmed()};
+            if (!value.startsWith("bytes="))
+            {
+                return 0;
+            }
+
+            const QByteArray start{value.mid(6).split('-').value(0)};
+            bool ok{false};
+            const qint64 offset{start.toLongLong(&ok)};
+            return ok ? offset : 0;
+        }
+        return 0;
+    }
+
+    QByteArray requestPath(const QByteArray &head)
+    {
+        const QList<QByteArray> requestLine{head.left(head.indexOf('\r')).split(' ')};
+        return requestLine.value(1);
+    }
+}
+
+FaultServer::FaultServer(QObject *parent)
+    : QObject(parent), server_(this)
+{
+    connect(&server_, &QTcpServer::newConnection, this, &FaultServer::handleNewConnection);
+}
+
+bool FaultServer::start(Fault fault, const QByteArray &payload)
+{
+    fault_ = fault;
+    payload_ = payload;
+    requestCount_ = 0;
+    bodyBytesServed_ = 0;
+    return server_.listen(QHostAddress::LocalHost, 0);
+}
+
+QUrl FaultServer::url() const
+{
+    const QString path{fault_ == Fault::RedirectLoop ? QStringLiteral("/loop") : QStringLiteral("/payload.bin")};
+    return QUrl{QStringLiteral("http://127.0.0.1:%1%2").arg(server_.serverPort()).arg(path)};
+}
+
+int FaultServer::requestCount() const
+{
+    return requestCount_;
+}
+
+qint64 FaultServer::bodyBytesServed() const
+{
+    return bodyBytesServed_;
+}
+
+void FaultServer::handleNewConnection()
+{
+    while (QTcpSocket *socket{server_.nextPendingConnection()})
+    {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+
+        auto buffer{std::make_shared<QByteArray>()};
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket, buffer]()
+                {
+                    buffer->append(socket->readAll());
+                    const qsizetype end{buffer->indexOf("\r\n\r\n")};
+                    if (end < 0)
+                    {
+                        return;
+                    }
+
+                    const QByteArray head{buffer->left(end)};
+                    buffer->clear();
+                    socket->disconnect(this);
+                    handleRequest(socket, head); });
+    }
+}
+
+void FaultServer::handleRequest(QTcpSocket *socket, const QByteArray &head)
+{
+    ++requestCount_;
+    const bool firstRequest{requestCount_ == 1};
+
+    if (fault_ == Fault::RedirectLoop || requestPath(head) == "/loop")
+    {
+        socket->write("HTTP/1.1 302 Found\r\n"
+                      "Location: /loop\r\n"
+                      "Content-Length: 0\r\n"
+                      "Connection: close\r\n\r\n");
+        socket->disconnectFromHost();
+        return;
+    }
+
+    qint64 offset{qBound<qint64>(0, parseRangeStart(head), payload_.size())};
+    if (fault_ == Fault::IgnoreRange)
+    {
+        offset = 0;
+    }
+
+    const QByteArray body{payload_.mid(offset)};
+    QByteArray response{};
+    if (offset > 0)
+    {
+        response += "HTTP/1.1 206 Partial Content\r\n";
+        response += "Content-Range: bytes " + QByteArray::number(offset) + '-' + QByteArray::number(payload_.size() - 1) + '/' + QByteArray::number(payload_.size()) + "\r\n";
+    }
+    else
+    {
+        response += "HTTP/1.1 200 OK\r\n";
+    }
+    response += "Accept-Ranges: bytes\r\n";
+    response += "Content-Type: application/octet-stream\r\n";
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    socket->write(response);
+
+    switch (fault_)
+    {
+    case Fault::MidStreamDisconnect:
+        sendBody(socket, body, firstRequest ? body.size() * 2 / 5 : body.size());
+        break;
+    case Fault::IgnoreRange:
+        sendBody(socket, body, firstRequest ? body.size() / 2 : body.size());
+        break;
+    case Fault::TruncatedBody:
+        sendBody(socket, body, firstRequest ? qMax<qint64>(0, body.size() - kTruncatedTailBytes) : body.size());
+        break;
+    case Fault::SlowDrip:
+        dripBody(socket, body);
+        break;
+    case Fault::None:
+    case Fault::RedirectLoop:
+        sendBody(socket, body, body.size());
+        break;
+    }
+}
+
+void FaultServer::sendBody(QTcpSocket *socket, const QByteArray &body, qint64 cutoff)
+{
+    const QByteArray sent{body.left(cutoff)};
+    socket->write(sent);
+    bodyBytesServed_ += sent.size();
+    socket->disconnectFromHost();
+}
+
+void FaultServer::dripBody(QTcpSocket *socket, const QByteArray &body)
+{
+    auto *timer{new QTimer(socket)};
+    auto position{std::make_shared<qint64>(0)};
+    timer->setInterval(kDripIntervalMs);
+    connect(timer, &QTimer::timeout, this, [this, socket, timer, body, position]()
+            {
+                if (socket->state() != QAbstractSocket::ConnectedState)
+                {
+                    timer->stop();
+                    return;
+                }
+
+                const QByteArray chunk{body.mid(*position, kDripChunkBytes)};
+                socket->write(chunk);
+                bodyBytesServed_ += chunk.size();
+                *position += chunk.size();
+                if (*position >= body.size())
+                {
+                    timer->stop();
+                    socket->disconnectFromHost();
+                } });
+    timer->start();
+}
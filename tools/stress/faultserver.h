@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QTcpServer>
+#include <QUrl>
+
+class QTcpSocket;
+
+class FaultServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Fault
+    {
+        None,
+        MidStreamDisconnect,
+        RedirectLoop,
+        IgnoreRange,
+        TruncatedBody,
+        SlowDrip
+    };
+
+    explicit FaultServer(QObject *parent = nullptr);
+
+    bool start(Fault fault, const QByteArray &payload);
+    QUrl url() const;
+
+    int requestCount() const;
+    qint64 bodyBytesServed() const;
+
+private slots:
+    void handleNewConnection();
+
+private:
+    void handleRequest(QTcpSocket *socket, const QByteArray &head);
+    void sendBody(QTcpSocket *socket, const QByteArray &body, qint64 cutoff);
+    void dripBody(QTcpSocket *socket, const QByteArray &body);
+
+    QTcpServer server_{};
+    Fault fault_{Fault::None};
+    QByteArray payload_{};
+    int requestCount_{0};
+    qint64 bodyBytesServed_{0};
+};
@@ -0,0 +1,50 @@
+#include "stressrunner.h"
+#include "tracer.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("downman-stress"));
+
+    QCommandLineParser parser{};
+    parser.setApplicationDescription(QStringLiteral("Runs DownloadItem against a local fault-injecting HTTP server."));
+    parser.addHelpOption();
+    const QCommandLineOption sizeOption{{QStringLiteral("s"), QStringLiteral("size")},
+                                        QStringLiteral("Payload size in bytes."),
+                                        QStringLiteral("bytes"),
+                                        QStringLiteral("4194304")};
+    const QCommandLineOption scenarioOption{QStringLiteral("scenario"),
+                                            QStringLiteral("Run only the named scenario (repeatable)."),
+                                            QStringLiteral("name")};
+    parser.addOption(sizeOption);
+    parser.addOption(scenarioOption);
+    parser.process(app);
+
+    const QString tracePath{qEnvironmentVariable("DOWNMAN_TRACE")};
+    if (!tracePath.isEmpty())
+    {
+        Tracer::instance().enable(tracePath);
+    }
+
+    const QStringList only{parser.values(scenarioOption)};
+    QList<StressRunner::Scenario> scenarios{};
+    for (const auto &scenario : StressRunner::defaultScenarios())
+    {
+        if (only.isEmpty() || only.contains(scenario.name))
+        {
+            scenarios.append(scenario);
+        }
+    }
+
+    StressRunner runner{qMax<qint64>(1, parser.value(sizeOption).toLongLong())};
+    QObject::connect(&runner, &StressRunner::finished, &app, [&app, &runner]()
+                     { app.exit(runner.allPassed() ? 0 : 1); });
+    runner.run(scenarios);
+
+    const int status{app.exec()};
+    Tracer::instance().flush();
+    return status;
+}
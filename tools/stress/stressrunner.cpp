@@ -0,0 +1,269 @@
+#include "stressrunner.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+
+namespace
+{
+    constexpr int kMaxAttempts{6};
+    constexpr int kRetryDelayMs{50};
+    constexpr int kScenarioTimeoutMs{60000};
+
+    QByteArray makePayload(qint64 size)
+    {
+        QByteArray payload(size, Qt::Uninitialized);
+        quint32 state{0x9E3779B9u};
+        for (qint64 i{0}; i < size; ++i)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            payload[i] = static_cast<char>(state & 0xFF);
+        }
+        return payload;
+    }
+}
+
+StressRunner::StressRunner(qint64 payloadSize, QObject *parent)
+    : QObject(parent),
+      payload_(makePayload(payloadSize)),
+      workDir_(QDir::homePath() + QStringLiteral("/.downman-stress-XXXXXX"))
+{
+    watchdog_.setSingleShot(true);
+    watchdog_.setInterval(kScenarioTimeoutMs);
+    connect(&watchdog_, &QTimer::timeout, this, &StressRunner::handleTimeout);
+}
+
+QList<StressRunner::Scenario> StressRunner::defaultScenarios()
+{
+    using Fault = FaultServer::Fault;
+    return {
+        Scenario{QStringLiteral("clean"), Fault::None, false, false},
+        Scenario{QStringLiteral("pause-resume"), Fault::None, true, false},
+        Scenario{QStringLiteral("mid-stream-disconnect"), Fault::MidStreamDisconnect, false, false},
+        Scenario{QStringLiteral("redirect-loop"), Fault::RedirectLoop, false, true},
+        Scenario{QStringLiteral("ignored-range"), Fault::IgnoreRange, false, false},
+        Scenario{QStringLiteral("truncated-body"), Fault::TruncatedBody, false, false},
+        Scenario{QStringLiteral("slow-drip"), Fault::SlowDrip, false, false},
+    };
+}
+
+void StressRunner::run(const QList<Scenario> &scenarios)
+{
+    pending_ = scenarios;
+    results_.clear();
+
+    if (!workDir_.isValid())
+    {
+        QTextStream{stderr} << "Cannot create work directory under " << QDir::homePath() << Qt::endl;
+        emit finished();
+        return;
+    }
+
+    QTimer::singleShot(0, this, &StressRunner::runNext);
+}
+
+bool StressRunner::allPassed() const
+{
+    for (const auto &result : results_)
+    {
+        if (!result.passed)
+        {
+            return false;
+        }
+    }
+    return !results_.isEmpty();
+}
+
+void StressRunner::runNext()
+{
+    item_.reset();
+    server_.reset();
+
+    if (pending_.isEmpty())
+    {
+        printReport();
+        emit finished();
+        return;
+    }
+
+    current_ = pending_.takeFirst();
+    firstFaultMs_ = -1;
+    attempts_ = 1;
+    retryPending_ = false;
+    pauseIssued_ = false;
+    scenarioDone_ = false;
+    targetPath_ = workDir_.filePath(current_.name + QStringLiteral(".bin"));
+    QFile::remove(targetPath_);
+
+    server_ = std::make_unique<FaultServer>();
+    if (!server_->start(current_.fault, payload_))
+    {
+        completeScenario(QStringLiteral("server failed to listen"));
+        return;
+    }
+
+    item_ = std::make_unique<DownloadItem>();
+    connect(item_.get(), &DownloadItem::downloadFinished, this, &StressRunner::handleFinished);
+    connect(item_.get(), &DownloadItem::downloadFailed, this, &StressRunner::handleFailed);
+    connect(item_.get(), &DownloadItem::paused, this, &StressRunner::handlePaused);
+    connect(item_.get(), &DownloadItem::progressChanged, this, &StressRunner::handleProgress);
+
+    clock_.start();
+    watchdog_.start();
+    item_->startNew(server_->url(), targetPath_);
+}
+
+void StressRunner::handleFinished(const QString &filePath)
+{
+    Q_UNUSED(filePath);
+    completeScenario(QStringLiteral("completed"));
+}
+
+void StressRunner::handleFailed(const QString &errorText)
+{
+    if (scenarioDone_)
+    {
+        return;
+    }
+
+    if (firstFaultMs_ < 0)
+    {
+        firstFaultMs_ = clock_.elapsed();
+    }
+
+    if (current_.expectFailure || attempts_ >= kMaxAttempts)
+    {
+        completeScenario(QStringLiteral("failed: ") + errorText);
+        return;
+    }
+
+    if (!retryPending_)
+    {
+        retryPending_ = true;
+        QTimer::singleShot(kRetryDelayMs, this, &StressRunner::retry);
+    }
+}
+
+void StressRunner::handlePaused()
+{
+    if (scenarioDone_ || retryPending_)
+    {
+        return;
+    }
+
+    retryPending_ = true;
+    QTimer::singleShot(kRetryDelayMs, this, &StressRunner::retry);
+}
+
+void StressRunner::handleProgress(qint64 bytesReceived, qint64 bytesTotal)
+{
+    if (!current_.pauseMidway || pauseIssued_ || bytesTotal <= 0 || bytesReceived * 10 < bytesTotal * 3)
+    {
+        return;
+    }
+
+    pauseIssued_ = true;
+    if (firstFaultMs_ < 0)
+    {
+        firstFaultMs_ = clock_.elapsed();
+    }
+    item_->pause();
+}
+
+void StressRunner::handleTimeout()
+{
+    completeScenario(QStringLiteral("timed out"));
+}
+
+void StressRunner::retry()
+{
+    retryPending_ = false;
+    if (scenarioDone_ || !item_)
+    {
+        return;
+    }
+
+    ++attempts_;
+    item_->resumeFromSaved();
+}
+
+void StressRunner::completeScenario(const QString &outcome)
+{
+    if (scenarioDone_)
+    {
+        return;
+    }
+    scenarioDone_ = true;
+    watchdog_.stop();
+
+    Result result{};
+    result.scenario = current_.name;
+    result.outcome = outcome;
+    result.attempts = attempts_;
+    result.totalMs = clock_.elapsed();
+
+    if (server_)
+    {
+        result.requests = server_->requestCount();
+        result.bytesServed = server_->bodyBytesServed();
+    }
+
+    if (current_.expectFailure)
+    {
+        result.fileCorrect = !outcome.startsWith(QLatin1String("completed"));
+        result.passed = result.fileCorrect && outcome != QLatin1String("timed out");
+    }
+    else
+    {
+        QFile file{targetPath_};
+        result.fileCorrect = file.open(QIODevice::ReadOnly) && file.readAll() == payload_;
+        result.bytesRedownloaded = qMax<qint64>(0, result.bytesServed - payload_.size());
+        result.passed = result.fileCorrect && outcome == QLatin1String("completed");
+    }
+
+    if (firstFaultMs_ >= 0)
+    {
+        result.recoveryMs = result.totalMs - firstFaultMs_;
+    }
+
+    if (item_)
+    {
+        item_->clearSavedState();
+    }
+    results_.append(result);
+    QTimer::singleShot(0, this, &StressRunner::runNext);
+}
+
+void StressRunner::printReport() const
+{
+    QTextStream out{stdout};
+    out << QStringLiteral("%1 %2 %3 %4 %5 %6 %7 %8 %9")
+               .arg(QStringLiteral("scenario"), -22)
+               .arg(QStringLiteral("result"), -6)
+               .arg(QStringLiteral("tries"), 5)
+               .arg(QStringLiteral("reqs"), 5)
+               .arg(QStringLiteral("served"), 11)
+               .arg(QStringLiteral("re-fetched"), 11)
+               .arg(QStringLiteral("recover ms"), 10)
+               .arg(QStringLiteral("total ms"), 9)
+               .arg(QStringLiteral("file"))
+        << Qt::endl;
+
+    for (const auto &result : results_)
+    {
+        out << QStringLiteral("%1 %2 %3 %4 %5 %6 %7 %8 %9")
+                   .arg(result.scenario, -22)
+                   .arg(result.passed ? QStringLiteral("PASS") : QStringLiteral("FAIL"), -6)
+                   .arg(result.attempts, 5)
+                   .arg(result.requests, 5)
+                   .arg(result.bytesServed, 11)
+                   .arg(result.bytesRedownloaded, 11)
+                   .arg(result.recoveryMs >= 0 ? QString::number(result.recoveryMs) : QStringLiteral("-"), 10)
+                   .arg(result.totalMs, 9)
+                   .arg(result.fileCorrect ? QStringLiteral("ok") : QStringLiteral("bad"))
+            << QStringLiteral("  (") << result.outcome << QStringLiteral(")") << Qt::endl;
+    }
+}
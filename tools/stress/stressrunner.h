@@ -0,0 +1,81 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QTemporaryDir>
+#include <QTimer>
+
+#include <memory>
+
+#include "downloaditem.h"
+#include "faultserver.h"
+
+class StressRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Scenario
+    {
+        QString name{};
+        FaultServer::Fault fault{FaultServer::Fault::None};
+        bool pauseMidway{false};
+        bool expectFailure{false};
+    };
+
+    struct Result
+    {
+        QString scenario{};
+        QString outcome{};
+        bool passed{false};
+        int attempts{0};
+        int requests{0};
+        qint64 bytesServed{0};
+        qint64 bytesRedownloaded{0};
+        qint64 recoveryMs{-1};
+        qint64 totalMs{0};
+        bool fileCorrect{false};
+    };
+
+    explicit StressRunner(qint64 payloadSize, QObject *parent = nullptr);
+
+    static QList<Scenario> defaultScenarios();
+
+    void run(const QList<Scenario> &scenarios);
+    bool allPassed() const;
+
+signals:
+    void finished();
+
+private slots:
+    void runNext();
+    void handleFinished(const QString &filePath);
+    void handleFailed(const QString &errorText);
+    void handlePaused();
+    void handleProgress(qint64 bytesReceived, qint64 bytesTotal);
+    void handleTimeout();
+    void retry();
+
+private:
+    void completeScenario(const QString &outcome);
+    void printReport() const;
+
+    QByteArray payload_{};
+    QTemporaryDir workDir_;
+    QList<Scenario> pending_{};
+    QList<Result> results_{};
+
+    Scenario current_{};
+    std::unique_ptr<FaultServer> server_{};
+    std::unique_ptr<DownloadItem> item_{};
+    QString targetPath_{};
+    QElapsedTimer clock_{};
+    qint64 firstFaultMs_{-1};
+    int attempts_{0};
+    bool retryPending_{false};
+    bool pauseIssued_{false};
+    bool scenarioDone_{false};
+    QTimer watchdog_{};
+};